@@ -0,0 +1,418 @@
+#include "ArchiveReader.h"
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <memory>
+
+#ifdef DEPSFINDER_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+using namespace std::filesystem;
+
+
+namespace
+{
+    enum class ArchiveType { None, Tar, TarGz, Zip };
+
+    ArchiveType archiveType(const path& file)
+    {
+        std::string name = file.filename().string();
+        std::transform(name.begin(), name.end(), name.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+        const auto endsWith = [&name](const std::string& suffix) {
+            return name.size() > suffix.size() && name.compare(name.size() - suffix.size(), suffix.size(), suffix) == 0;
+        };
+
+        if (endsWith(".tar"))
+            return ArchiveType::Tar;
+        if (endsWith(".zip"))
+            return ArchiveType::Zip;
+#ifdef DEPSFINDER_HAVE_ZLIB
+        if (endsWith(".tar.gz") || endsWith(".tgz"))
+            return ArchiveType::TarGz;
+#endif
+        return ArchiveType::None;
+    }
+
+
+    // Deflate can't compress better than this, whatever the data
+    constexpr uint64_t maxDeflateRatio = 1032;
+
+
+    // Sequential reading of a tar stream, compressed or not
+    class TarStream
+    {
+    public:
+        virtual ~TarStream() = default;
+        virtual bool read(char* buffer, size_t size) = 0;
+        virtual bool skip(uint64_t size) = 0;
+        // Bytes that may be left in the stream at most, headers trust nothing larger
+        virtual uint64_t available() = 0;
+    };
+
+    class FileTarStream : public TarStream
+    {
+    public:
+        explicit FileTarStream(const path& file) : m_file(file, std::ios::binary) {
+            std::error_code ec;
+            m_size = file_size(file, ec);
+        }
+
+        bool isOpen() const { return m_file.is_open(); }
+
+        uint64_t available() override {
+            const auto position = m_file.tellg();
+            return position < 0 || static_cast<uint64_t>(position) > m_size ? 0 : m_size - static_cast<uint64_t>(position);
+        }
+
+        bool read(char* buffer, size_t size) override {
+            return static_cast<bool>(m_file.read(buffer, static_cast<std::streamsize>(size)));
+        }
+
+        bool skip(uint64_t size) override {
+            return static_cast<bool>(m_file.seekg(static_cast<std::streamoff>(size), std::ios::cur));
+        }
+
+    private:
+        std::ifstream m_file;
+        uint64_t m_size = 0;
+    };
+
+#ifdef DEPSFINDER_HAVE_ZLIB
+    class GzTarStream : public TarStream
+    {
+    public:
+        explicit GzTarStream(const path& file) : m_file(gzopen(file.string().c_str(), "rb")) {
+            std::error_code ec;
+            const uint64_t size = file_size(file, ec);
+            m_limit = ec || size > UINT64_MAX / maxDeflateRatio ? UINT64_MAX : size * maxDeflateRatio;
+        }
+        ~GzTarStream() override {
+            if (m_file)
+                gzclose(m_file);
+        }
+
+        bool isOpen() const { return m_file != nullptr; }
+
+        // the rest of the content isn't known without inflating it,
+        // but it can't be larger than the file inflated at the best ratio
+        uint64_t available() override {
+            return m_limit - std::min<uint64_t>(m_limit, m_read);
+        }
+
+        bool read(char* buffer, size_t size) override {
+            m_read += size;
+            while (size > 0) {
+                const unsigned portion = static_cast<unsigned>(std::min<size_t>(size, 1u << 30));
+                if (gzread(m_file, buffer, portion) != static_cast<int>(portion))
+                    return false;
+                buffer += portion;
+                size -= portion;
+            }
+            return true;
+        }
+
+        bool skip(uint64_t size) override {
+            // a compressed stream can only be skipped by decompressing it
+            std::array<char, 1 << 16> buffer;
+            while (size > 0) {
+                const size_t portion = static_cast<size_t>(std::min<uint64_t>(size, buffer.size()));
+                if (!read(buffer.data(), portion))
+                    return false;
+                size -= portion;
+            }
+            return true;
+        }
+
+    private:
+        gzFile m_file;
+        uint64_t m_limit = UINT64_MAX;
+        uint64_t m_read = 0;
+    };
+#endif
+
+
+    constexpr size_t tarBlock = 512;
+
+    uint64_t tarPadding(uint64_t size) {
+        return (tarBlock - size % tarBlock) % tarBlock;
+    }
+
+    // Numeric header fields are octal text, or big-endian binary if the
+    // high bit of the first byte is set (GNU extension for large files)
+    uint64_t tarNumber(const char* field, size_t size) {
+        uint64_t value = 0;
+        if (static_cast<unsigned char>(field[0]) & 0x80) {
+            for (size_t i = 1; i < size; ++i)
+                value = value << 8 | static_cast<unsigned char>(field[i]);
+            return value;
+        }
+        for (size_t i = 0; i < size && field[i]; ++i)
+            if (field[i] >= '0' && field[i] <= '7')
+                value = value * 8 + (field[i] - '0');
+        return value;
+    }
+
+    // The checksum is the sum of the header bytes with its own field taken as
+    // spaces; some old writers summed signed chars
+    bool tarChecksumValid(const std::array<char, tarBlock>& header) {
+        uint64_t sum = 0;
+        int64_t signedSum = 0;
+        for (size_t i = 0; i < header.size(); ++i) {
+            const bool field = i >= 148 && i < 156;
+            sum += field ? ' ' : static_cast<unsigned char>(header[i]);
+            signedSum += field ? ' ' : static_cast<signed char>(header[i]);
+        }
+        const uint64_t checksum = tarNumber(&header[148], 8);
+        return checksum == sum || static_cast<int64_t>(checksum) == signedSum;
+    }
+
+    // Reads size bytes and the padding after them; the bound of a compressed
+    // stream is loose, so memory grows only with the data actually read
+    bool tarData(TarStream& tar, uint64_t size, std::string& data) {
+        constexpr size_t portion = 16 << 20;
+        if (size > tar.available() || size > data.max_size())
+            return false;
+        data.clear();
+        while (data.size() < size) {
+            const size_t done = data.size();
+            data.resize(done + static_cast<size_t>(std::min<uint64_t>(size - done, portion)));
+            if (!tar.read(data.data() + done, data.size() - done))
+                return false;
+        }
+        return tar.skip(tarPadding(size));
+    }
+
+    std::string tarString(const char* field, size_t size) {
+        return std::string(field, strnlen(field, size));
+    }
+
+    // Extracts the "path" record of a pax extended header, "<length> path=<value>\n"
+    std::string paxPath(const std::string& records) {
+        size_t pos = 0;
+        while (pos < records.size()) {
+            const size_t space = records.find(' ', pos);
+            if (space == std::string::npos)
+                break;
+            const size_t length = std::strtoul(records.c_str() + pos, nullptr, 10);
+            if (length == 0 || pos + length > records.size())
+                break;
+            const std::string record = records.substr(space + 1, pos + length - space - 2);
+            if (record.compare(0, 5, "path=") == 0)
+                return record.substr(5);
+            pos += length;
+        }
+        return {};
+    }
+
+    bool readTar(TarStream& tar,
+                 const std::function<bool(const std::string&)>& accept,
+                 const std::function<bool(const std::string&, std::string&)>& onMember)
+    {
+        std::array<char, tarBlock> header;
+        std::string longName;
+        while (tar.read(header.data(), header.size()))
+        {
+            // the archive ends with zero blocks
+            if (std::all_of(header.begin(), header.end(), [](char c) { return c == 0; }))
+                return true;
+            if (!tarChecksumValid(header))
+                return false;
+
+            const uint64_t size = tarNumber(&header[124], 12);
+            const char type = header[156];
+
+            if (type == 'L' || type == 'x') {
+                std::string data;
+                if (!tarData(tar, size, data))
+                    return false;
+                longName = type == 'L' ? tarString(data.data(), data.size()) : paxPath(data);
+                continue;
+            }
+
+            std::string name = longName;
+            longName.clear();
+            if (name.empty()) {
+                name = tarString(&header[0], 100);
+                const std::string prefix = tarString(&header[345], 155);
+                if (std::memcmp(&header[257], "ustar", 5) == 0 && !prefix.empty())
+                    name = prefix + "/" + name;
+            }
+
+            const bool regularFile = type == '0' || type == '\0' || type == '7';
+            if (!regularFile || !accept(name)) {
+                if (size > tar.available() || !tar.skip(size + tarPadding(size)))
+                    return false;
+                continue;
+            }
+
+            std::string content;
+            if (!tarData(tar, size, content))
+                return false;
+            if (!onMember(name, content))
+                return true;
+        }
+        // no end of archive blocks, it's truncated
+        return false;
+    }
+
+
+    uint16_t le16(const char* p) {
+        return static_cast<uint16_t>(static_cast<unsigned char>(p[0]) | static_cast<unsigned char>(p[1]) << 8);
+    }
+
+    uint32_t le32(const char* p) {
+        return static_cast<uint32_t>(le16(p)) | static_cast<uint32_t>(le16(p + 2)) << 16;
+    }
+
+    bool inflateRaw(const std::string& compressed, std::string& content) {
+#ifdef DEPSFINDER_HAVE_ZLIB
+        z_stream stream{};
+        if (inflateInit2(&stream, -MAX_WBITS) != Z_OK)
+            return false;
+        stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(compressed.data()));
+        stream.avail_in = static_cast<uInt>(compressed.size());
+        stream.next_out = reinterpret_cast<Bytef*>(content.data());
+        stream.avail_out = static_cast<uInt>(content.size());
+        const int status = inflate(&stream, Z_FINISH);
+        inflateEnd(&stream);
+        return status == Z_STREAM_END && stream.avail_out == 0;
+#else
+        (void)compressed;
+        (void)content;
+        return false;
+#endif
+    }
+
+    // Members are found through the central directory at the end of the archive
+    bool readZip(const path& archive,
+                 const std::function<bool(const std::string&)>& accept,
+                 const std::function<bool(const std::string&, std::string&)>& onMember)
+    {
+        std::ifstream zip(archive, std::ios::binary | std::ios::ate);
+        if (!zip.is_open())
+            return false;
+
+        constexpr size_t endRecordSize = 22;
+        const uint64_t archiveSize = static_cast<uint64_t>(zip.tellg());
+        const size_t tailSize = static_cast<size_t>(std::min<uint64_t>(archiveSize, endRecordSize + 0xFFFF));
+        std::string tail(tailSize, '\0');
+        zip.seekg(static_cast<std::streamoff>(archiveSize - tailSize));
+        if (tailSize < endRecordSize || !zip.read(tail.data(), tail.size()))
+            return false;
+
+        size_t endRecord = std::string::npos;
+        for (size_t i = tailSize - endRecordSize + 1; i-- > 0; )
+            if (le32(&tail[i]) == 0x06054b50) {
+                endRecord = i;
+                break;
+            }
+        if (endRecord == std::string::npos)
+            return false;
+
+        const uint16_t entries = le16(&tail[endRecord + 10]);
+        const uint32_t directorySize = le32(&tail[endRecord + 12]);
+        const uint32_t directoryOffset = le32(&tail[endRecord + 16]);
+        if (entries == 0xFFFF || directoryOffset == 0xFFFFFFFF || uint64_t(directoryOffset) + directorySize > archiveSize)
+            return false; // zip64
+
+        std::string directory(directorySize, '\0');
+        zip.seekg(directoryOffset);
+        if (!zip.read(directory.data(), directory.size()))
+            return false;
+
+        bool intact = true;
+        size_t pos = 0;
+        for (uint16_t entry = 0; entry < entries; ++entry)
+        {
+            if (pos + 46 > directory.size() || le32(&directory[pos]) != 0x02014b50)
+                return false;
+            const uint16_t flags = le16(&directory[pos + 8]);
+            const uint16_t method = le16(&directory[pos + 10]);
+            const uint32_t compressedSize = le32(&directory[pos + 20]);
+            const uint32_t size = le32(&directory[pos + 24]);
+            const uint16_t nameLength = le16(&directory[pos + 28]);
+            const uint16_t extraLength = le16(&directory[pos + 30]);
+            const uint16_t commentLength = le16(&directory[pos + 32]);
+            const uint32_t localOffset = le32(&directory[pos + 42]);
+            if (pos + 46 + nameLength > directory.size())
+                return false;
+            const std::string name = directory.substr(pos + 46, nameLength);
+            pos += 46 + nameLength + extraLength + commentLength;
+
+            if (name.empty() || name.back() == '/' || !accept(name))
+                continue;
+            // encrypted, zip64 or compressed other than deflate
+            if ((flags & 1) || compressedSize == 0xFFFFFFFF || size == 0xFFFFFFFF || (method != 0 && method != 8)) {
+                intact = false;
+                continue;
+            }
+
+            char local[30];
+            zip.seekg(localOffset);
+            if (!zip.read(local, sizeof(local)) || le32(local) != 0x04034b50)
+                return false;
+            zip.seekg(le16(local + 26) + le16(local + 28), std::ios::cur);
+
+            // sizes come from the archive, nothing is allocated for more than it can hold
+            const auto dataOffset = static_cast<uint64_t>(zip.tellg());
+            if (!zip || dataOffset > archiveSize || compressedSize > archiveSize - dataOffset)
+                return false;
+            if (size > (method == 0 ? compressedSize : uint64_t(compressedSize) * maxDeflateRatio)) {
+                intact = false;
+                continue;
+            }
+
+            std::string compressed(compressedSize, '\0');
+            if (!zip.read(compressed.data(), compressed.size()))
+                return false;
+
+            std::string content;
+            if (method == 0) {
+                content = std::move(compressed);
+            } else {
+                content.resize(size);
+                if (!inflateRaw(compressed, content)) {
+                    intact = false;
+                    continue;
+                }
+            }
+            if (!onMember(name, content))
+                return intact;
+        }
+        return intact;
+    }
+}
+
+
+bool IsArchive(const path& file)
+{
+    return archiveType(file) != ArchiveType::None;
+}
+
+
+bool ReadArchive(const path& archive,
+                 const std::function<bool(const std::string& member)>& accept,
+                 const std::function<bool(const std::string& member, std::string& content)>& onMember)
+{
+    switch (archiveType(archive)) {
+    case ArchiveType::Tar: {
+        FileTarStream tar(archive);
+        return tar.isOpen() && readTar(tar, accept, onMember);
+    }
+#ifdef DEPSFINDER_HAVE_ZLIB
+    case ArchiveType::TarGz: {
+        GzTarStream tar(archive);
+        return tar.isOpen() && readTar(tar, accept, onMember);
+    }
+#endif
+    case ArchiveType::Zip:
+        return readZip(archive, accept, onMember);
+    default:
+        return false;
+    }
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <filesystem>
+#include <functional>
+#include <string>
+
+
+// True for archives scanned in place: .tar, .tar.gz, .tgz and .zip
+// (compressed ones only if built with zlib)
+bool IsArchive(const std::filesystem::path& file);
+
+// Streams regular file members of the archive into memory one by one, no
+// temporary files involved. Only members accepted by the filter are read,
+// onMember gets the member name and content and returns false to stop.
+// Returns false if the archive is damaged or uses an unsupported feature,
+// members read before that are reported anyway.
+bool ReadArchive(const std::filesystem::path& archive,
+                 const std::function<bool(const std::string& member)>& accept,
+                 const std::function<bool(const std::string& member, std::string& content)>& onMember);
@@ -0,0 +1,207 @@
+#include "BytePairSet.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define BYTEPAIRS_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define BYTEPAIRS_TARGET_SSE2 __attribute__((target("sse2")))
+#define BYTEPAIRS_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define BYTEPAIRS_TARGET_SSE2
+#define BYTEPAIRS_TARGET_AVX2
+#endif
+
+
+namespace
+{
+    using Pairs = std::vector<std::array<unsigned char, 2>>;
+    using Kernel = size_t (*)(const unsigned char*, size_t, const Pairs&, std::vector<size_t>&);
+
+    int countTrailingZeros(uint32_t bits) {
+#ifdef _MSC_VER
+        unsigned long index;
+        _BitScanForward(&index, bits);
+        return static_cast<int>(index);
+#else
+        return __builtin_ctz(bits);
+#endif
+    }
+
+    // Kernels scan as many whole blocks as fit and return the position
+    // the scalar tail should continue from; without SIMD it is all the text
+    size_t scalarKernel(const unsigned char*, size_t, const Pairs&, std::vector<size_t>&) {
+        return 0;
+    }
+
+#ifdef BYTEPAIRS_X86
+    // Lowercases ASCII letters: adds 0x20 to bytes within 'A'..'Z', the range
+    // check is a signed compare of bytes shifted so that 'A' becomes -128
+    BYTEPAIRS_TARGET_SSE2
+    __m128i foldCase(__m128i bytes) {
+        const __m128i shifted = _mm_add_epi8(bytes, _mm_set1_epi8(static_cast<char>(128 - 'A')));
+        const __m128i isUpper = _mm_cmplt_epi8(shifted, _mm_set1_epi8(static_cast<char>(-128 + 26)));
+        return _mm_or_si128(bytes, _mm_and_si128(isUpper, _mm_set1_epi8(0x20)));
+    }
+
+    BYTEPAIRS_TARGET_AVX2
+    __m256i foldCase(__m256i bytes) {
+        const __m256i shifted = _mm256_add_epi8(bytes, _mm256_set1_epi8(static_cast<char>(128 - 'A')));
+        const __m256i isUpper = _mm256_cmpgt_epi8(_mm256_set1_epi8(static_cast<char>(-128 + 26)), shifted);
+        return _mm256_or_si256(bytes, _mm256_and_si256(isUpper, _mm256_set1_epi8(0x20)));
+    }
+
+    template <bool FoldCase>
+    BYTEPAIRS_TARGET_SSE2
+    size_t sse2Kernel(const unsigned char* text, size_t size, const Pairs& pairs, std::vector<size_t>& candidates) {
+        size_t i = 0;
+        for (; i + 16 < size; i += 16) {
+            __m128i current = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text + i));
+            __m128i next = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text + i + 1));
+            if constexpr (FoldCase) {
+                current = foldCase(current);
+                next = foldCase(next);
+            }
+            __m128i hits = _mm_setzero_si128();
+            for (const auto& pair : pairs) {
+                hits = _mm_or_si128(hits, _mm_and_si128(
+                    _mm_cmpeq_epi8(current, _mm_set1_epi8(static_cast<char>(pair[0]))),
+                    _mm_cmpeq_epi8(next, _mm_set1_epi8(static_cast<char>(pair[1])))));
+            }
+            for (uint32_t bits = static_cast<uint32_t>(_mm_movemask_epi8(hits)); bits; bits &= bits - 1)
+                candidates.push_back(i + countTrailingZeros(bits));
+        }
+        return i;
+    }
+
+    template <bool FoldCase>
+    BYTEPAIRS_TARGET_AVX2
+    size_t avx2Kernel(const unsigned char* text, size_t size, const Pairs& pairs, std::vector<size_t>& candidates) {
+        size_t i = 0;
+        for (; i + 32 < size; i += 32) {
+            __m256i current = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(text + i));
+            __m256i next = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(text + i + 1));
+            if constexpr (FoldCase) {
+                current = foldCase(current);
+                next = foldCase(next);
+            }
+            __m256i hits = _mm256_setzero_si256();
+            for (const auto& pair : pairs) {
+                hits = _mm256_or_si256(hits, _mm256_and_si256(
+                    _mm256_cmpeq_epi8(current, _mm256_set1_epi8(static_cast<char>(pair[0]))),
+                    _mm256_cmpeq_epi8(next, _mm256_set1_epi8(static_cast<char>(pair[1])))));
+            }
+            for (uint32_t bits = static_cast<uint32_t>(_mm256_movemask_epi8(hits)); bits; bits &= bits - 1)
+                candidates.push_back(i + countTrailingZeros(bits));
+        }
+        return i;
+    }
+
+    // Always there on x86-64, not on every i386
+    bool cpuHasSse2() {
+#ifdef _MSC_VER
+        int regs[4];
+        __cpuid(regs, 1);
+        return (regs[3] & (1 << 26)) != 0;
+#else
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("sse2");
+#endif
+    }
+
+    bool cpuHasAvx2() {
+#ifdef _MSC_VER
+        int regs[4];
+        __cpuid(regs, 1);
+        const bool osSavesYmm = (regs[2] & (1 << 27)) && (regs[2] & (1 << 28)) && (_xgetbv(0) & 6) == 6;
+        __cpuidex(regs, 7, 0);
+        return osSavesYmm && (regs[1] & (1 << 5));
+#else
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2");
+#endif
+    }
+#endif
+
+    struct KernelChoice
+    {
+        Kernel kernel;
+        Kernel foldCaseKernel;
+        const char* name;
+    };
+
+    // Fastest first, the first one is selected
+    const std::vector<KernelChoice>& availableKernels() {
+        static const std::vector<KernelChoice> kernels = []() {
+            std::vector<KernelChoice> kernels;
+#ifdef BYTEPAIRS_X86
+            if (cpuHasAvx2())
+                kernels.push_back({ avx2Kernel<false>, avx2Kernel<true>, "avx2" });
+            if (cpuHasSse2())
+                kernels.push_back({ sse2Kernel<false>, sse2Kernel<true>, "sse2" });
+#endif
+            kernels.push_back({ scalarKernel, scalarKernel, "scalar" });
+            return kernels;
+        }();
+        return kernels;
+    }
+
+    const KernelChoice& selectedKernel() {
+        return availableKernels().front();
+    }
+}
+
+
+void BytePairSet::insert(unsigned char first, unsigned char second)
+{
+    if (contains(first, second))
+        return;
+    if (m_foldCase) {
+        first = FoldAsciiCase(first);
+        second = FoldAsciiCase(second);
+    }
+    m_table.set(first << 8 | second);
+    m_pairs.push_back({ first, second });
+}
+
+
+void BytePairSet::findCandidates(const char* text, size_t size, std::vector<size_t>& candidates, const char* kernel) const
+{
+    if (m_pairs.empty() || size < 2)
+        return;
+
+    const auto* bytes = reinterpret_cast<const unsigned char*>(text);
+    const auto& kernels = availableKernels();
+    const auto named = std::find_if(kernels.begin(), kernels.end(), [kernel](const KernelChoice& choice) {
+        return kernel && std::strcmp(choice.name, kernel) == 0;
+    });
+    const KernelChoice& choice = named != kernels.end() ? *named : selectedKernel();
+    size_t i = (m_foldCase ? choice.foldCaseKernel : choice.kernel)(bytes, size, m_pairs, candidates);
+    for (; i + 1 < size; ++i) {
+        if (contains(bytes[i], bytes[i + 1]))
+            candidates.push_back(i);
+    }
+}
+
+
+const char* BytePairSet::kernelName()
+{
+    return selectedKernel().name;
+}
+
+
+std::vector<const char*> BytePairSet::kernelNames()
+{
+    std::vector<const char*> names;
+    for (const auto& choice : availableKernels())
+        names.push_back(choice.name);
+    return names;
+}
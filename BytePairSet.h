@@ -0,0 +1,56 @@
+#pragma once
+
+#include <array>
+#include <bitset>
+#include <cstddef>
+#include <vector>
+
+
+// Lowercases ASCII letters, leaves any other byte as is
+inline unsigned char FoldAsciiCase(unsigned char c)
+{
+    return (c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c;
+}
+
+
+// Set of two-byte fingerprints with a vectorized search for them in a text.
+// Used as a pre-filter: only positions where a fingerprint occurs can be
+// the place of a searched name, so only those are checked by exact matching.
+// The search kernel (AVX2, SSE2 or scalar) is chosen once at runtime.
+// With foldCase the pairs and the text are compared ignoring ASCII case,
+// the text is folded inside the kernel at no extra pass over it.
+class BytePairSet
+{
+public:
+    explicit BytePairSet(bool foldCase = false) : m_foldCase(foldCase) {}
+
+    void insert(unsigned char first, unsigned char second);
+
+    bool contains(unsigned char first, unsigned char second) const {
+        if (m_foldCase) {
+            first = FoldAsciiCase(first);
+            second = FoldAsciiCase(second);
+        }
+        return m_table[first << 8 | second];
+    }
+
+    bool foldCase() const { return m_foldCase; }
+
+    bool empty() const { return m_pairs.empty(); }
+
+    // Appends to candidates every position i of text where
+    // (text[i], text[i + 1]) is one of the pairs; the kernel is one of
+    // kernelNames(), the selected one if null or unknown
+    void findCandidates(const char* text, size_t size, std::vector<size_t>& candidates, const char* kernel = nullptr) const;
+
+    // Name of the search kernel selected for this CPU
+    static const char* kernelName();
+
+    // Kernels this CPU can run, the selected one first and "scalar" last
+    static std::vector<const char*> kernelNames();
+
+private:
+    std::vector<std::array<unsigned char, 2>> m_pairs;
+    std::bitset<1 << 16> m_table;
+    bool m_foldCase;
+};
@@ -0,0 +1,227 @@
+#include "DependenciesDelta.h"
+
+#include <algorithm>
+#include <fstream>
+
+using namespace std::filesystem;
+
+
+namespace
+{
+    constexpr char snapshotMagic[8] = { 'D', 'E', 'P', 'S', 'S', 'N', 'A', 'P' };
+    constexpr uint32_t snapshotVersion = 1;
+
+    const std::string namePrefix = "Name of the file \"";
+    const std::string nameSuffix = "\" is present in file(s):";
+    const std::string wherePrefix = "\t\"";
+
+    template <typename T>
+    void writeValue(std::ostream& out, T value) {
+        out.write(reinterpret_cast<const char*>(&value), sizeof(value));
+    }
+
+    template <typename T>
+    bool readValue(std::istream& in, T& value) {
+        return static_cast<bool>(in.read(reinterpret_cast<char*>(&value), sizeof(value)));
+    }
+
+    // Maps ids of sorted names into ids of the sorted union of names,
+    // the map is monotonic, so sorted edges stay sorted after it
+    std::vector<std::string> mergeNames(const std::vector<std::string>& l, const std::vector<std::string>& r,
+                                        std::vector<uint32_t>& lIds, std::vector<uint32_t>& rIds)
+    {
+        std::vector<std::string> names;
+        names.reserve(std::max(l.size(), r.size()));
+        lIds.resize(l.size());
+        rIds.resize(r.size());
+        size_t i = 0, j = 0;
+        while (i < l.size() || j < r.size()) {
+            const auto id = static_cast<uint32_t>(names.size());
+            if (j == r.size() || (i < l.size() && l[i] < r[j])) {
+                lIds[i] = id;
+                names.push_back(l[i++]);
+            } else if (i == l.size() || r[j] < l[i]) {
+                rIds[j] = id;
+                names.push_back(r[j++]);
+            } else {
+                lIds[i++] = id;
+                rIds[j] = id;
+                names.push_back(r[j++]);
+            }
+        }
+        return names;
+    }
+}
+
+
+DependencyEdges ToEdges(const Dependencies& dependencies)
+{
+    DependencyEdges result;
+    for (const auto& [searched, where] : dependencies) {
+        result.names.push_back(searched);
+        for (const auto& scanned : where)
+            result.names.push_back(scanned.generic_string());
+    }
+    std::sort(result.names.begin(), result.names.end());
+    result.names.erase(std::unique(result.names.begin(), result.names.end()), result.names.end());
+
+    const auto id = [&result](const std::string& name) {
+        return static_cast<uint32_t>(std::lower_bound(result.names.begin(), result.names.end(), name) - result.names.begin());
+    };
+    for (const auto& [searched, where] : dependencies) {
+        const uint32_t searchedId = id(searched);
+        for (const auto& scanned : where)
+            result.edges.emplace_back(searchedId, id(scanned.generic_string()));
+    }
+    // generic_string() may order differently than path comparison does
+    std::sort(result.edges.begin(), result.edges.end());
+    return result;
+}
+
+
+DependenciesDelta CompareDependencies(const DependencyEdges& previous, const DependencyEdges& current)
+{
+    std::vector<uint32_t> previousIds, currentIds;
+    const std::vector<std::string> names = mergeNames(previous.names, current.names, previousIds, currentIds);
+
+    const auto remap = [](const std::pair<uint32_t, uint32_t>& edge, const std::vector<uint32_t>& ids) {
+        return std::make_pair(ids[edge.first], ids[edge.second]);
+    };
+    const auto record = [&names](Dependencies& dependencies, const std::pair<uint32_t, uint32_t>& edge) {
+        dependencies[names[edge.first]].insert(names[edge.second]);
+    };
+
+    DependenciesDelta delta;
+    auto p = previous.edges.begin();
+    auto c = current.edges.begin();
+    while (p != previous.edges.end() || c != current.edges.end()) {
+        if (c == current.edges.end()) {
+            record(delta.removed, remap(*p++, previousIds));
+            continue;
+        }
+        if (p == previous.edges.end()) {
+            record(delta.added, remap(*c++, currentIds));
+            continue;
+        }
+        const auto previousEdge = remap(*p, previousIds);
+        const auto currentEdge = remap(*c, currentIds);
+        if (previousEdge < currentEdge) {
+            record(delta.removed, previousEdge);
+            ++p;
+        } else if (currentEdge < previousEdge) {
+            record(delta.added, currentEdge);
+            ++c;
+        } else {
+            ++p;
+            ++c;
+        }
+    }
+    return delta;
+}
+
+
+bool ReadDependencies(const path& input, Dependencies& dependencies)
+{
+    std::ifstream results(input);
+    if (!results.is_open())
+        return false;
+
+    std::set<path>* where_ = nullptr;
+    std::string line;
+    while (std::getline(results, line)) {
+        if (line.compare(0, wherePrefix.size(), wherePrefix) == 0 && where_) {
+            where_->insert(line.substr(wherePrefix.size()));
+        } else if (line.size() >= namePrefix.size() + nameSuffix.size()
+                   && line.compare(0, namePrefix.size(), namePrefix) == 0
+                   && line.compare(line.size() - nameSuffix.size(), nameSuffix.size(), nameSuffix) == 0) {
+            where_ = &dependencies[line.substr(namePrefix.size(), line.size() - namePrefix.size() - nameSuffix.size())];
+        }
+    }
+    return true;
+}
+
+
+// Layout: magic, version, names count, every name as length and bytes,
+// edges count, every edge as two ids; all numbers are native endian.
+// Counts and lengths are checked against the rest of the file before
+// anything is allocated for them, a damaged snapshot is just not read.
+bool ReadSnapshot(const path& input, DependencyEdges& edges)
+{
+    std::error_code ec;
+    const std::uintmax_t fileSize = file_size(input, ec);
+    if (ec)
+        return false;
+    std::ifstream snapshot(input, std::ios::binary);
+    const auto fits = [&](std::uint64_t count, std::uint64_t itemSize) {
+        const auto position = static_cast<std::uintmax_t>(snapshot.tellg());
+        return position <= fileSize && count <= (fileSize - position) / itemSize;
+    };
+
+    char magic[sizeof(snapshotMagic)];
+    uint32_t version = 0;
+    if (!snapshot.read(magic, sizeof(magic)) || !std::equal(magic, magic + sizeof(magic), snapshotMagic)
+        || !readValue(snapshot, version) || version != snapshotVersion)
+        return false;
+
+    DependencyEdges read;
+    uint32_t namesCount = 0;
+    if (!readValue(snapshot, namesCount) || !fits(namesCount, sizeof(uint32_t)))
+        return false;
+    read.names.resize(namesCount);
+    for (auto& name : read.names) {
+        uint32_t length = 0;
+        if (!readValue(snapshot, length) || !fits(length, 1))
+            return false;
+        name.resize(length);
+        if (!snapshot.read(name.data(), length))
+            return false;
+    }
+
+    uint64_t edgesCount = 0;
+    if (!readValue(snapshot, edgesCount) || !fits(edgesCount, 2 * sizeof(uint32_t)))
+        return false;
+    read.edges.resize(static_cast<size_t>(edgesCount));
+    for (auto& edge : read.edges)
+        if (!readValue(snapshot, edge.first) || !readValue(snapshot, edge.second) || edge.first >= namesCount || edge.second >= namesCount)
+            return false;
+    edges = std::move(read);
+    return true;
+}
+
+
+bool WriteSnapshot(const path& output, const DependencyEdges& edges)
+{
+    std::ofstream snapshot(output, std::ios::binary);
+    snapshot.write(snapshotMagic, sizeof(snapshotMagic));
+    writeValue(snapshot, snapshotVersion);
+    writeValue(snapshot, static_cast<uint32_t>(edges.names.size()));
+    for (const auto& name : edges.names) {
+        writeValue(snapshot, static_cast<uint32_t>(name.size()));
+        snapshot.write(name.data(), static_cast<std::streamsize>(name.size()));
+    }
+    writeValue(snapshot, static_cast<uint64_t>(edges.edges.size()));
+    for (const auto& edge : edges.edges) {
+        writeValue(snapshot, edge.first);
+        writeValue(snapshot, edge.second);
+    }
+    return static_cast<bool>(snapshot);
+}
+
+
+void WriteDependenciesDelta(const path& output, const DependenciesDelta& delta)
+{
+    std::ofstream results(output);
+    const auto write = [&results](const Dependencies& dependencies, const char* change) {
+        for (const auto& dep : dependencies)
+        {
+            results << "Name of the file \"" << dep.first << "\" is " << change << " file(s):";
+            for (const auto& where_ : dep.second)
+            {
+                results << "\n\t\"" << where_.generic_string();
+            }
+            results << std::endl;
+        }
+    };
+    write(delta.added, "added to");
+    write(delta.removed, "removed from");
+}
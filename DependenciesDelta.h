@@ -0,0 +1,37 @@
+#pragma once
+
+#include "DepsFinder.h"
+
+#include <cstdint>
+
+
+// Dependencies as sorted edges between sorted unique names.
+// An id is an index in names, so ids compare as the names do and two
+// edge lists are compared by a linear merge of integer pairs.
+struct DependencyEdges
+{
+    std::vector<std::string> names;
+    std::vector<std::pair<uint32_t, uint32_t>> edges; // searched id, scanned id
+};
+
+
+struct DependenciesDelta
+{
+    Dependencies added;
+    Dependencies removed;
+};
+
+
+DependencyEdges ToEdges(const Dependencies& dependencies);
+
+DependenciesDelta CompareDependencies(const DependencyEdges& previous, const DependencyEdges& current);
+
+// Reads the text written by WriteDependencies, false if there is no such file
+bool ReadDependencies(const std::filesystem::path& input, Dependencies& dependencies);
+
+// Compact binary form of the edges, much faster to load than the text;
+// ReadSnapshot returns false on a damaged file, leaving the edges as they are
+bool ReadSnapshot(const std::filesystem::path& input, DependencyEdges& edges);
+bool WriteSnapshot(const std::filesystem::path& output, const DependencyEdges& edges);
+
+void WriteDependenciesDelta(const std::filesystem::path& output, const DependenciesDelta& delta);
@@ -1,48 +1,45 @@
 #include "INIReader.h"
 
-#include "TasksPool.h"
+#include "DepsFinderConfig.h"
 
-#include <array>
-#include <iostream>
-#include <filesystem>
-#include <list>
-#include <fstream>
-#include <regex>
-#include <map>
-#include <set>
-#include <vector>
-#include <future>
 #include <algorithm>
+#include <atomic>
+#include <csignal>
+#include <iostream>
+#include <chrono>
+#include <optional>
+#include <stdexcept>
+#include <string>
 
 using namespace std::filesystem;
 
 
-struct Params
-{
-    std::list<path> searchedDirs;
-    std::list<path> scannedDirs;
-    std::regex searched_extentions_pattern;
-    std::regex scanned_extentions_pattern;
-};
-
+std::optional<std::chrono::milliseconds> ParseDuration(const std::string& text);
 
-Params FetchParameters(INIReader& iniReader);
-
-std::list<path> FilterFilesByExtentions(const std::list<path>& sourceDirs, const std::regex& extentionsPattern);
-
-std::map<std::string, std::set<path>> DetectDependencies(const std::list<path>& searched, const std::list<path>& scanned);
+std::atomic<bool> interrupted = false;
 
 
 
 int main(int argc, char** argv)
 {
     //  
-    if (argc > 2) {
-        std::cout << "RTFM!!!" << std::endl;
-        return -1;
+    std::string configName = "config.ini";
+    std::optional<std::chrono::milliseconds> timeBudget;
+    bool configGiven = false;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "--deadline" && i + 1 < argc && (timeBudget = ParseDuration(argv[i + 1]))) {
+            ++i;
+        } else if (!configGiven && arg.rfind("--", 0) != 0) {
+            configName = arg;
+            configGiven = true;
+        } else {
+            std::cout << "RTFM!!!" << std::endl;
+            return -1;
+        }
     }
 
-    INIReader ini((argc == 2) ? argv[1] : "config.ini");
+    INIReader ini(configName);
 
     if (ini.ParseError() < 0)
     {
@@ -51,152 +48,107 @@ int main(int argc, char** argv)
     }
 
     //    .ini-
-    Params params = FetchParameters(ini);
-
-    //      
-    std::list<path> searched_FileNames = FilterFilesByExtentions(params.searchedDirs, params.searched_extentions_pattern);
-    std::list<path> scanned_FileNames = FilterFilesByExtentions(params.scannedDirs, params.scanned_extentions_pattern);
-
-    std::cout << "Searching dependencies of ";
-    for (const auto& dir : params.searchedDirs)
-        std::cout << dir << " ";
-    std::cout << " in ";
-    for (const auto& dir : params.scannedDirs)
-        std::cout << dir << " ";
-    std::cout << " (" << scanned_FileNames.size() << " files)\n";
+    std::vector<Params> params;
+    try {
+        params = FetchJobs(ini);
+    }
+    catch (const std::invalid_argument& e) {
+        std::cout << "Wrong jobs: " << e.what() << "\n";
+        return -1;
+    }
 
     const auto start = std::chrono::steady_clock::now();
 
-    //       
-    const auto potentialDependencies = DetectDependencies(searched_FileNames, scanned_FileNames);
-
-    const auto finish = std::chrono::steady_clock::now();
-    std::cout << "\nWorked " << std::chrono::duration_cast<std::chrono::milliseconds>(finish - start).count() << "ms\n";
+    // Ctrl+C stops listing and searching files, but what is found is still written;
+    // a second one kills the process, should a read hang and stopping with it
+    SearchOptions options;
+    options.cancel = &interrupted;
+    options.performance = FetchPerformance(ini);
+    std::signal(SIGINT, [](int) {
+        interrupted = true;
+        std::signal(SIGINT, SIG_DFL);
+    });
+    if (timeBudget)
+        options.deadline = start + *timeBudget;
+    options.onProgress = [](short percentage) {
+        if (percentage == 0)
+            std::cout << "[0%] preparing...\r";
+        else if (percentage < 100)
+            std::cout << "[" << std::min(5 + percentage, 99) << "%] searching...\r";
+        else
+            std::cout << "[100%] done.             \n";
+    };
 
-    std::cout << "Writing results to dependencies.txt\n";
-    //   
-    std::ofstream results("dependencies.txt");
-    for (const auto& dep : potentialDependencies)
-    {
-        results << "Name of the file \"" << dep.first << "\" is present in file(s):";
-        for (const auto& where_ : dep.second)
-        {
-            results << "\n\t\"" << where_.generic_string();
-        }
-        results << std::endl;
+    //      
+    const std::vector<Job> jobs = MakeJobs(params, options);
+
+    for (size_t j = 0; j < jobs.size(); ++j) {
+        if (!jobs[j].name.empty())
+            std::cout << "[" << jobs[j].name << "] ";
+        std::cout << "Searching dependencies of ";
+        for (const auto& dir : params[j].searchedDirs)
+            std::cout << dir << " ";
+        std::cout << " in ";
+        for (const auto& dir : params[j].scannedDirs)
+            std::cout << dir << " ";
+        std::cout << " (" << jobs[j].scannedFiles.size() << " files";
+        if (!jobs[j].scannedArchives.empty())
+            std::cout << ", " << jobs[j].scannedArchives.size() << " archives";
+        if (!jobs[j].scannedRevisions.empty())
+            std::cout << ", " << jobs[j].scannedRevisions.size() << " revisions of " << jobs[j].gitRepository;
+        std::cout << ")\n";
     }
 
-    return 0;
-}
-
-
-
-Params FetchParameters(INIReader& iniReader)
-{
-    Params params;
-    params.searchedDirs = iniReader.GetPathList("PATHS", "Searched");
-    params.scannedDirs = iniReader.GetPathList("PATHS", "Scanned");
-
-    std::list<std::string> searched_extentions = iniReader.GetStringList("EXTENTIONS", "Searched");
-    std::list<std::string> scanned_extentions = iniReader.GetStringList("EXTENTIONS", "Scanned");
-
-    std::string searched_regStr = "(";
-    std::string scanned_regStr = "(";
-
-    for (const auto& str : searched_extentions) {
-        searched_regStr += "\\" + str + "|";
+    //       
+    Result result;
+    try {
+        result = FindDependencies(jobs, {}, options);
     }
-    for (const auto& str : scanned_extentions) {
-        scanned_regStr += "\\" + str + "|";
+    catch (const std::exception& e) {
+        std::cout << "\nCan't compile searched patterns: " << e.what() << "\n";
+        return -1;
     }
-    searched_regStr.back() = ')';
-    scanned_regStr.back() = ')';
 
-    params.searched_extentions_pattern = std::regex(searched_regStr);
-    params.scanned_extentions_pattern = std::regex(scanned_regStr);
+    for (const auto& unreadable : result.unreadable)
+        std::cout << "Cannot open " << unreadable << "\n";
 
-    return params;
-}
-
-
-std::list<path> FilterFilesByExtentions(const std::list<path>& sourceDirs, const std::regex& extentionsPattern)
-{
-    std::list<path> filtered_files;
-    for (const auto& sourceDir : sourceDirs)
-    {
-        if (!std::filesystem::exists(sourceDir))
-        {
-            std::cout << "Path doesn't exist:\n\t" << sourceDir << "\n";
-            continue;
-        }
+    const auto finish = std::chrono::steady_clock::now();
+    std::cout << "\nWorked " << std::chrono::duration_cast<std::chrono::milliseconds>(finish - start).count() << "ms\n";
+    if (!result.complete)
+        std::cout << (interrupted ? "Interrupted" : "Deadline reached") << ", results are partial\n";
 
-        recursive_directory_iterator source_it(sourceDir);
-        for (; source_it != recursive_directory_iterator(); ++source_it)
-        {
-            if (source_it->is_directory())
-                continue;
+    //   
+    for (size_t j = 0; j < jobs.size(); ++j)
+        WriteJobResults(params[j], result.dependencies[j], result.unscanned[j]);
 
-            if (std::regex_match(source_it->path().extension().string(), extentionsPattern))
-            {
-                filtered_files.push_back(source_it->path());
-            }
-        }
-    }
-    return filtered_files;
+    return result.complete ? 0 : 2;
 }
 
 
-//  unordered_map< 
-//                          key:  ,
-//                          value:  ,     
-//                         >
-std::map<std::string, std::set<path>> DetectDependencies(const std::list<path>& searched_FileNames, const std::list<path>& scanned_FileNames)
+// Parses durations like 1500ms, 30s, 5m, 1h; a bare number is seconds
+std::optional<std::chrono::milliseconds> ParseDuration(const std::string& text)
 {
-    std::map<std::string, std::set<path>> potentialDependencies;
-
-    std::cout << "[0%] preparing...\r";
-    {
-        std::mutex mut_writeDependency;
-        TasksPool todo;
-
-        size_t i = 0;
-        for (const auto& scanned_FileName : scanned_FileNames) {
-            if (++i % ((scanned_FileNames.size()/5)+1) == 0)
-                std::cout << "[" << i * 5 / scanned_FileNames.size() << "%] searching...  \r";
-            todo.addTask([scanned_FileName, &searched_FileNames, &mut_writeDependency, &potentialDependencies]()
-                {
-                    std::string scanned_FileContent;
-                    {
-                        std::ifstream scanned_File(scanned_FileName);
-
-                        if (!scanned_File.is_open()) {
-                            std::cout << "Cannot open " << scanned_FileName << "\n";
-                            return;
-                        }
-                        scanned_FileContent = std::string((std::istreambuf_iterator<char>(scanned_File)), std::istreambuf_iterator<char>());
-                    }
-
-                    for (const auto& searched_FileName : searched_FileNames)
-                    {
-                        std::regex pattern_toSearch(searched_FileName.filename().string());
-                        if (std::regex_search(scanned_FileContent, pattern_toSearch))
-                        {
-                            std::lock_guard<std::mutex> lock(mut_writeDependency);
-                            potentialDependencies[searched_FileName.generic_string()].insert(scanned_FileName);
-                        }
-                    }
-                });
-        }
-
-        // reporting percentage
-        for (short percentage = 0; percentage < 90; percentage = todo.progress()) {
-            std::cout << "["<< 5 + percentage <<"%] searching...\r";
-            std::this_thread::sleep_for(std::chrono::seconds(4));
-        }
-
-        std::cout << "[98%] searching...        \r";
+    size_t end = 0;
+    double value = 0;
+    try {
+        value = std::stod(text, &end);
+    }
+    catch (const std::exception&) {
+        return std::nullopt;
     }
-    std::cout << "[100%] done.             \n";
 
-    return potentialDependencies;
+    const std::string unit = text.substr(end);
+    double factor = 0;
+    if (unit == "ms")
+        factor = 1;
+    else if (unit.empty() || unit == "s")
+        factor = 1000;
+    else if (unit == "m")
+        factor = 60 * 1000;
+    else if (unit == "h")
+        factor = 60 * 60 * 1000;
+
+    if (factor == 0 || value < 0)
+        return std::nullopt;
+    return std::chrono::milliseconds(static_cast<long long>(value * factor));
 }
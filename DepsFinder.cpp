@@ -0,0 +1,538 @@
+#include "DepsFinder.h"
+
+#include "ArchiveReader.h"
+#include "GitRepository.h"
+#include "LiteralMatcher.h"
+#include "RegexDfa.h"
+#include "TasksPool.h"
+#include "TokenMatcher.h"
+
+#include <algorithm>
+#include <fstream>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string_view>
+
+using namespace std::filesystem;
+
+
+namespace
+{
+    // Overlap for patterns of unlimited length, such files are never split
+    constexpr std::uintmax_t unboundedOverlap = std::numeric_limits<std::uintmax_t>::max();
+
+
+    // Searched names of one job, compiled once and shared by all the tasks
+    class JobMatcher
+    {
+    public:
+        explicit JobMatcher(const Job& job);
+
+        // Overlap needed between chunks of a split file, unboundedOverlap if
+        // a pattern may match a text of any length
+        std::uintmax_t overlap() const;
+
+        // Appends searched files and patterns whose names are in the content,
+        // which is a chunk of a file unless it starts or ends the file
+        void search(std::string_view content, std::vector<const std::string*>& found,
+                    bool fileStart = true, bool fileEnd = true) const;
+
+    private:
+        std::vector<std::vector<std::string>> m_owners;        // searched files by name index
+        std::vector<std::vector<std::string>> m_tokenOwners;   // searched files by token name index
+        std::vector<std::vector<std::string>> m_patternOwners; // searched files or patterns by pattern index
+        std::optional<LiteralMatcher> m_matcher;
+        std::optional<TokenMatcher> m_tokens;
+        std::optional<RegexDfa> m_dfa;
+    };
+
+
+    // A piece of a scanned file to be searched by one task
+    struct ScanTask
+    {
+        path file;
+        std::uintmax_t offset = 0;
+        std::uintmax_t length = 0;           // bytes to read, 0 if the file size is unknown
+        std::vector<size_t> jobs;            // jobs the file is scanned for
+        const std::string* buffer = nullptr; // in-memory content, if any
+        bool archive = false;                // members are read and searched one by one
+        const GitRepository* repository = nullptr; // if set, the content is this blob
+        GitObjectId blob{};
+        std::vector<std::vector<path>> names{}; // by task job, paths of the blob in scanned revisions
+        bool tail = true;                       // the chunk ends the file
+    };
+
+
+    // Names the results of the n-th job of the task are reported under
+    std::vector<path> ReportedNames(const ScanTask& task, size_t n)
+    {
+        return task.repository ? task.names[n] : std::vector<path>{ task.file };
+    }
+
+
+    JobMatcher::JobMatcher(const Job& job)
+    {
+        // Searched files with the same name are matched once, names are
+        // compared literally by a matcher built once for all the tasks
+        std::map<std::string, std::vector<std::string>> searchedByName;
+        for (const auto& searched_FileName : job.searchedFiles)
+            searchedByName[searched_FileName.filename().string()].push_back(searched_FileName.generic_string());
+
+        std::vector<std::string> names;
+        for (auto& [name, searched] : searchedByName) {
+            names.push_back(name);
+            m_owners.push_back(std::move(searched));
+        }
+
+        // Regex patterns are compiled once into a single DFA and reported
+        // under the pattern itself; with the DFA engine escaped names join them
+        // With the token engine names are looked up as whole tokens, except
+        // for names with characters tokens can't have, left to the literal matcher
+        std::vector<std::string> tokenNames;
+        if (job.engine == MatchEngine::Token) {
+            std::vector<std::string> literalNames;
+            std::vector<std::vector<std::string>> literalOwners;
+            for (size_t i = 0; i < names.size(); ++i) {
+                const bool token = TokenMatcher::isTokenName(names[i]);
+                (token ? tokenNames : literalNames).push_back(std::move(names[i]));
+                (token ? m_tokenOwners : literalOwners).push_back(std::move(m_owners[i]));
+            }
+            names = std::move(literalNames);
+            m_owners = std::move(literalOwners);
+        }
+
+        std::vector<std::string> patterns;
+        if (job.engine == MatchEngine::Dfa) {
+            for (const auto& name : names)
+                patterns.push_back(RegexDfa::escape(name));
+            m_patternOwners = std::move(m_owners);
+            names.clear();
+            m_owners.clear();
+        }
+        for (const auto& [written, regex] : job.searchedPatterns) {
+            patterns.push_back(regex);
+            m_patternOwners.push_back({ written });
+        }
+
+        m_matcher.emplace(std::move(names), job.caseInsensitive);
+        m_tokens.emplace(std::move(tokenNames), job.caseInsensitive);
+        m_dfa.emplace(patterns, job.caseInsensitive);
+    }
+
+
+    std::uintmax_t JobMatcher::overlap() const
+    {
+        if (m_dfa->maxMatchLength() == RegexDfa::unbounded)
+            return unboundedOverlap;
+        // a token needs a byte of context on each side and may end with a dot
+        const std::uintmax_t tokenOverlap = m_tokenOwners.empty() ? 0 : m_tokens->maxLength() + 2;
+        return std::max({ m_matcher->maxLength(), tokenOverlap, m_dfa->maxMatchLength() });
+    }
+
+
+    void JobMatcher::search(std::string_view content, std::vector<const std::string*>& found, bool fileStart, bool fileEnd) const
+    {
+        const auto record = [&found](const std::vector<bool>& matched, const std::vector<std::vector<std::string>>& owners) {
+            for (size_t n = 0; n < matched.size(); ++n)
+            {
+                if (!matched[n])
+                    continue;
+                for (const auto& searched_FileName : owners[n])
+                    found.push_back(&searched_FileName);
+            }
+        };
+
+        if (!m_owners.empty()) {
+            std::vector<bool> matched(m_owners.size());
+            m_matcher->search(content, matched);
+            record(matched, m_owners);
+        }
+
+        if (!m_tokenOwners.empty()) {
+            std::vector<bool> matched(m_tokenOwners.size());
+            m_tokens->search(content, matched, fileStart, fileEnd);
+            record(matched, m_tokenOwners);
+        }
+
+        if (!m_patternOwners.empty()) {
+            std::vector<bool> matched(m_patternOwners.size());
+            m_dfa->search(content, matched);
+            record(matched, m_patternOwners);
+        }
+    }
+
+
+    // One task per distinct blob of the scanned revisions, whatever the number
+    // of revisions, paths and jobs it has; revisions that can't be found are unreadable,
+    // those left unlisted when stopped are unscanned
+    std::vector<ScanTask> PlanRevisionTasks(const std::vector<Job>& jobs, const std::map<path, GitRepository>& repositories,
+                                            const SearchOptions& options, Result& result)
+    {
+        std::vector<ScanTask> tasks;
+        std::map<std::pair<const GitRepository*, GitObjectId>, size_t> taskByBlob;
+        for (size_t j = 0; j < jobs.size(); ++j)
+            for (const auto& revision : jobs[j].scannedRevisions) {
+                if (options.stopped()) {
+                    result.unscanned[j].insert(revision + ":");
+                    continue;
+                }
+                const GitRepository& repository = repositories.at(jobs[j].gitRepository);
+                const auto tree = repository.valid() ? repository.resolveTree(revision) : std::nullopt;
+                const auto onBlob = [&](const std::string& file, const GitObjectId& blob) {
+                    if (jobs[j].isScannedMember && !jobs[j].isScannedMember(file))
+                        return;
+                    const path name = revision + ":" + file;
+                    const auto [found, added] = taskByBlob.try_emplace({ &repository, blob }, tasks.size());
+                    if (added)
+                        tasks.push_back({ name, 0, 0, {}, nullptr, false, &repository, blob });
+                    auto& task = tasks[found->second];
+                    if (task.jobs.empty() || task.jobs.back() != j) {
+                        task.jobs.push_back(j);
+                        task.names.emplace_back();
+                    }
+                    task.names.back().push_back(name);
+                };
+                if (!tree || !repository.listTree(*tree, onBlob))
+                    result.unreadable.push_back(jobs[j].gitRepository.generic_string() + "@" + revision);
+            }
+
+        for (auto& task : tasks)
+            if (!options.stopped())
+                task.length = task.repository->size(task.blob);
+        return tasks;
+    }
+
+
+    // Splits scanned files into tasks sorted by size, largest first.
+    // Files much larger than an average share of work per core are cut into
+    // chunks overlapping by the longest searched name, so no match is lost on a cut
+    // (unless the overlap is unbounded). With a memory budget chunks are also
+    // small enough for every worker to hold one. Once stopped, sizes are no
+    // longer asked for: the tasks are planned only to be reported unscanned.
+    std::vector<ScanTask> PlanScanTasks(const std::vector<Job>& jobs, const InMemoryFiles& inMemoryFiles, std::uintmax_t overlap,
+                                        const std::map<path, GitRepository>& repositories, const SearchOptions& options,
+                                        Result& result, std::uintmax_t& chunkSize)
+    {
+        const PerformanceOptions& performance = options.performance;
+        constexpr std::uintmax_t minChunkSize = 1 << 20;
+        constexpr std::uintmax_t minBudgetChunkSize = 64 << 10;
+
+        std::map<path, std::vector<size_t>> scanned_FileNames;
+        for (size_t j = 0; j < jobs.size(); ++j)
+            for (const auto& scanned_FileName : jobs[j].scannedFiles) {
+                auto& fileJobs = scanned_FileNames[scanned_FileName];
+                if (std::find(fileJobs.begin(), fileJobs.end(), j) == fileJobs.end())
+                    fileJobs.push_back(j);
+            }
+
+        std::vector<ScanTask> tasks;
+        std::uintmax_t totalSize = 0;
+        for (const auto& [scanned_FileName, fileJobs] : scanned_FileNames) {
+            const auto inMemory = inMemoryFiles.find(scanned_FileName);
+            if (inMemory != inMemoryFiles.end()) {
+                tasks.push_back({ scanned_FileName, 0, inMemory->second.size(), fileJobs, &inMemory->second });
+            } else {
+                std::error_code ec;
+                const auto size = options.stopped() ? 0 : file_size(scanned_FileName, ec);
+                tasks.push_back({ scanned_FileName, 0, ec ? 0 : size, fileJobs });
+            }
+            totalSize += tasks.back().length;
+        }
+
+        // archives are read sequentially, so each is one task of its size
+        std::map<path, std::vector<size_t>> scannedArchives;
+        for (size_t j = 0; j < jobs.size(); ++j)
+            for (const auto& archive : jobs[j].scannedArchives) {
+                auto& archiveJobs = scannedArchives[archive];
+                if (std::find(archiveJobs.begin(), archiveJobs.end(), j) == archiveJobs.end())
+                    archiveJobs.push_back(j);
+            }
+
+        std::vector<ScanTask> archiveTasks;
+        for (const auto& [archive, archiveJobs] : scannedArchives) {
+            std::error_code ec;
+            const auto size = options.stopped() ? 0 : file_size(archive, ec);
+            archiveTasks.push_back({ archive, 0, ec ? 0 : size, archiveJobs, nullptr, true });
+        }
+
+        const std::uintmax_t cores = performance.threads ? performance.threads : TasksPool::defaultThreads(performance.cpus);
+        chunkSize = std::max(minChunkSize, totalSize / (cores * 4));
+        if (performance.maxBufferMemory > 0)
+            chunkSize = std::min(chunkSize, std::max(minBudgetChunkSize, performance.maxBufferMemory / (cores + performance.ioThreads)));
+
+        std::vector<ScanTask> splitTasks = std::move(archiveTasks);
+        for (auto& task : PlanRevisionTasks(jobs, repositories, options, result))
+            splitTasks.push_back(std::move(task));
+        for (const auto& task : tasks) {
+            if (task.length <= 2 * chunkSize || overlap == unboundedOverlap) {
+                splitTasks.push_back(task);
+                continue;
+            }
+            for (std::uintmax_t offset = 0; offset < task.length; offset += chunkSize) {
+                splitTasks.push_back({ task.file, offset, std::min(chunkSize + overlap, task.length - offset), task.jobs, task.buffer });
+                splitTasks.back().tail = offset + splitTasks.back().length == task.length;
+            }
+        }
+
+        std::stable_sort(splitTasks.begin(), splitTasks.end(), [](const ScanTask& l, const ScanTask& r) {
+            return l.length > r.length;
+        });
+        return splitTasks;
+    }
+
+
+    // Bytes a read task holds in memory, asked again if unknown when planned
+    std::uintmax_t HeldSize(const ScanTask& task)
+    {
+        if (task.length > 0)
+            return task.length;
+        if (task.repository)
+            return task.repository->size(task.blob);
+        std::error_code ec;
+        const auto size = file_size(task.file, ec);
+        return ec ? 0 : size;
+    }
+
+
+    // Reads length bytes from offset, or the whole file if length is 0
+    bool ReadFileChunk(const path& file, std::uintmax_t offset, std::uintmax_t length, std::string& content)
+    {
+        std::ifstream scanned_File(file, std::ios::binary);
+        if (!scanned_File.is_open())
+            return false;
+
+        if (length == 0) {
+            content = std::string((std::istreambuf_iterator<char>(scanned_File)), std::istreambuf_iterator<char>());
+            return true;
+        }
+
+        content.resize(static_cast<size_t>(length));
+        scanned_File.seekg(static_cast<std::streamoff>(offset));
+        scanned_File.read(content.data(), static_cast<std::streamsize>(length));
+        content.resize(static_cast<size_t>(scanned_File.gcount()));
+        return true;
+    }
+
+
+    // Searches members of the archive accepted by its jobs, returns false if
+    // stopped before the end; a damaged archive is reported as unreadable
+    bool ScanArchive(const ScanTask& task, const std::vector<Job>& jobs, const std::vector<JobMatcher>& matchers,
+                     const std::atomic<bool>& stopping, std::mutex& mut_writeDependency, Result& result)
+    {
+        const auto scans = [&jobs](size_t j, const std::string& member) {
+            return !jobs[j].isScannedMember || jobs[j].isScannedMember(member);
+        };
+
+        bool stopped = false;
+        const bool intact = ReadArchive(task.file,
+            [&](const std::string& member) {
+                return std::any_of(task.jobs.begin(), task.jobs.end(), [&](size_t j) { return scans(j, member); });
+            },
+            [&](const std::string& member, std::string& content) {
+                std::vector<std::pair<size_t, std::vector<const std::string*>>> found;
+                for (const size_t j : task.jobs) {
+                    if (stopping) {
+                        stopped = true;
+                        return false;
+                    }
+                    if (scans(j, member)) {
+                        found.emplace_back(j, std::vector<const std::string*>());
+                        matchers[j].search(content, found.back().second);
+                    }
+                }
+
+                const path scanned_FileName = task.file.generic_string() + "!" + member;
+                std::lock_guard<std::mutex> lock(mut_writeDependency);
+                for (const auto& [j, searched] : found)
+                    for (const auto* searched_FileName : searched)
+                        result.dependencies[j][*searched_FileName].insert(scanned_FileName);
+                return true;
+            });
+
+        if (!intact) {
+            std::lock_guard<std::mutex> lock(mut_writeDependency);
+            result.unreadable.push_back(task.file);
+        }
+        return !stopped;
+    }
+}
+
+
+Result FindDependencies(const std::vector<Job>& jobs, const InMemoryFiles& inMemoryFiles, const SearchOptions& options)
+{
+    Result result;
+    result.dependencies.resize(jobs.size());
+    result.unscanned.resize(jobs.size());
+    for (size_t j = 0; j < jobs.size(); ++j)
+        result.unscanned[j] = jobs[j].unscannedDirs;
+
+    if (options.onProgress)
+        options.onProgress(0);
+
+    std::mutex mut_writeDependency;
+
+    std::vector<JobMatcher> matchers;
+    std::uintmax_t overlap = 0;
+    for (const auto& job : jobs) {
+        matchers.emplace_back(job);
+        overlap = std::max(overlap, matchers.back().overlap());
+    }
+
+    // Repositories are shared by the jobs scanning their revisions,
+    // their caches take a share of the memory budget
+    std::map<path, GitRepository> repositories;
+    for (const auto& job : jobs)
+        if (!job.scannedRevisions.empty())
+            repositories.try_emplace(job.gitRepository, job.gitRepository);
+    if (options.performance.maxBufferMemory > 0)
+        for (auto& [dir, repository] : repositories)
+            repository.setBaseCacheLimit(static_cast<size_t>(std::min<std::uintmax_t>(64 << 20, options.performance.maxBufferMemory / 4)));
+
+    // Every chunk is read once and searched for all its jobs
+    const PerformanceOptions& performance = options.performance;
+    std::uintmax_t chunkSize = 0;
+    const std::vector<ScanTask> tasks = PlanScanTasks(jobs, inMemoryFiles, overlap, repositories, options, result, chunkSize);
+    std::vector<char> finished(tasks.size(), false);
+
+    // Separate readers may run ahead of the searchers by a buffer per worker at most
+    // if no budget is given
+    const bool separateReaders = performance.ioThreads > 0;
+    const unsigned workers = (performance.threads ? performance.threads : TasksPool::defaultThreads(performance.cpus)) + performance.ioThreads;
+    MemoryBudget budget(performance.maxBufferMemory > 0 || !separateReaders ? performance.maxBufferMemory : 2 * workers * chunkSize);
+
+    // A file too large to hold or failing otherwise is unreadable, the search goes on
+    const auto guarded = [&mut_writeDependency, &result](const ScanTask& task, char& done, const std::function<void()>& scan) {
+        try {
+            scan();
+        }
+        catch (const std::exception&) {
+            std::lock_guard<std::mutex> lock(mut_writeDependency);
+            result.unreadable.push_back(task.file);
+            done = true;
+        }
+    };
+    {
+        // set along with cancelling the pool, for what is declared before it
+        std::atomic<bool> stopping = false;
+
+        const auto search = [&stopping, &matchers, &mut_writeDependency, &result](const ScanTask& task, std::string_view content, char& done) {
+            std::vector<std::vector<const std::string*>> found(task.jobs.size());
+            for (size_t n = 0; n < task.jobs.size(); ++n) {
+                if (stopping)
+                    return;
+                matchers[task.jobs[n]].search(content, found[n], task.offset == 0, task.tail);
+            }
+
+            std::lock_guard<std::mutex> lock(mut_writeDependency);
+            for (size_t n = 0; n < task.jobs.size(); ++n) {
+                const std::vector<path> names = ReportedNames(task, n);
+                for (const auto* searched_FileName : found[n])
+                    result.dependencies[task.jobs[n]][*searched_FileName].insert(names.begin(), names.end());
+            }
+            done = true;
+        };
+
+        // declared after all the tasks use, so that it waits for them before they are destroyed
+        TasksPool todo(performance.threads, performance.ioThreads, performance.cpus, performance.pinThreads);
+        const auto stop = [&]() {
+            stopping = true;
+            todo.cancel();
+            budget.cancel();
+        };
+
+        for (size_t i = 0; i < tasks.size(); ++i) {
+            // planning may take long enough for the search to be over before it starts
+            if (options.stopped()) {
+                stop();
+                break;
+            }
+            const ScanTask& task = tasks[i];
+            // archives hold the budget while read and searched, on the I/O lane like the
+            // readers: a searching worker waiting for the budget might wait for buffers
+            // whose searches are queued behind it
+            if (task.archive) {
+                todo.addTask([&task, &done = finished[i], &todo, &stopping, &jobs, &matchers, &budget, &guarded, &mut_writeDependency, &result]()
+                    {
+                        if (todo.cancelled() || !budget.acquire(task.length))
+                            return;
+                        guarded(task, done, [&]() { done = ScanArchive(task, jobs, matchers, stopping, mut_writeDependency, result); });
+                        budget.release(task.length);
+                    }, task.length, TasksPool::Lane::Io);
+                continue;
+            }
+
+            if (task.buffer) {
+                todo.addTask([&task, &done = finished[i], &todo, &search, &guarded]()
+                    {
+                        if (!todo.cancelled())
+                            guarded(task, done, [&]() {
+                                search(task, std::string_view(*task.buffer).substr(static_cast<size_t>(task.offset), static_cast<size_t>(task.length)), done);
+                            });
+                    }, task.length);
+                continue;
+            }
+
+            // the buffer returns its size to the budget when the last task holding it is done or dropped
+            todo.addTask([&task, &done = finished[i], &todo, &budget, &search, &guarded, separateReaders, &mut_writeDependency, &result]()
+                {
+                    const std::uintmax_t held = HeldSize(task);
+                    if (todo.cancelled() || !budget.acquire(held))
+                        return;
+                    guarded(task, done, [&]() {
+                        const std::shared_ptr<std::string> scanned_FileContent(new std::string, [&budget, held](std::string* content) {
+                            delete content;
+                            budget.release(held);
+                        });
+
+                        if (!(task.repository ? task.repository->read(task.blob, *scanned_FileContent)
+                                              : ReadFileChunk(task.file, task.offset, task.length, *scanned_FileContent))) {
+                            std::lock_guard<std::mutex> lock(mut_writeDependency);
+                            result.unreadable.push_back(task.file);
+                            done = true;
+                            return;
+                        }
+
+                        if (separateReaders)
+                            todo.addTask([&task, &done, &todo, &search, &guarded, scanned_FileContent]()
+                                {
+                                    if (!todo.cancelled())
+                                        guarded(task, done, [&]() { search(task, *scanned_FileContent, done); });
+                                }, task.length);
+                        else
+                            search(task, *scanned_FileContent, done);
+                    });
+                }, task.length, TasksPool::Lane::Io);
+        }
+
+        // waiting for tasks, reporting percentage and stopping them when it's time
+        auto lastReport = std::chrono::steady_clock::now();
+        while (!todo.waitIdle(std::chrono::milliseconds(50))) {
+            const auto now = std::chrono::steady_clock::now();
+            if (!todo.cancelled() && options.stopped())
+                stop();
+            if (options.onProgress && now - lastReport >= std::chrono::seconds(4)) {
+                options.onProgress(todo.progress());
+                lastReport = now;
+            }
+        }
+    }
+    if (options.onProgress)
+        options.onProgress(100);
+
+    for (size_t i = 0; i < tasks.size(); ++i) {
+        if (finished[i])
+            continue;
+        for (size_t n = 0; n < tasks[i].jobs.size(); ++n)
+            for (const auto& name : ReportedNames(tasks[i], n))
+                result.unscanned[tasks[i].jobs[n]].insert(name);
+    }
+    result.complete = std::all_of(result.unscanned.begin(), result.unscanned.end(), [](const auto& unscanned) { return unscanned.empty(); });
+
+    // chunks of a split file fail each
+    std::sort(result.unreadable.begin(), result.unreadable.end());
+    result.unreadable.erase(std::unique(result.unreadable.begin(), result.unreadable.end()), result.unreadable.end());
+
+    return result;
+}
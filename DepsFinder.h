@@ -0,0 +1,101 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <list>
+#include <map>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+
+// How searched file names are matched: literal names with a SIMD pre-filter,
+// escaped and compiled into the same DFA as the regex patterns, or looked up
+// as whole path-like tokens, so that foo.h is not found in barfoo.h
+enum class MatchEngine
+{
+    Literal,
+    Dfa,
+    Token
+};
+
+
+// Searched file or pattern -> scanned files containing its name
+using Dependencies = std::map<std::string, std::set<std::filesystem::path>>;
+
+// Contents of scanned files kept in memory, e.g. unsaved editor buffers.
+// A buffer is scanned instead of the file of the same path, which doesn't
+// have to exist, as long as the path is among the scanned files of a job.
+using InMemoryFiles = std::map<std::filesystem::path, std::string>;
+
+
+// Names to search for and files to search them in
+struct Job
+{
+    std::string name;
+    std::list<std::filesystem::path> searchedFiles; // file names are searched, reported by full path
+    std::list<std::pair<std::string, std::string>> searchedPatterns; // as reported, as regular expression
+    std::list<std::filesystem::path> scannedFiles;
+    std::list<std::filesystem::path> scannedArchives; // members are scanned in place, see ArchiveReader.h
+    std::filesystem::path gitRepository;     // scanned revisions are read from its object database
+    std::list<std::string> scannedRevisions; // files of these revisions are reported as "<revision>:<path>"
+    std::function<bool(const std::filesystem::path&)> isScannedMember; // archive members and revision files to scan, all if empty
+    bool caseInsensitive = false;
+    MatchEngine engine = MatchEngine::Literal;
+    std::set<std::filesystem::path> unscannedDirs; // not walked to the end, the listing was stopped
+};
+
+
+// Resources the search may take, 0 or empty for no limit
+struct PerformanceOptions
+{
+    unsigned threads = 0;               // searching workers, one per core (or per CPU given) by default
+    unsigned ioThreads = 0;             // workers only reading files, if 0 the searching ones read them
+    std::vector<unsigned> cpus;         // CPUs the workers may run on
+    bool pinThreads = false;            // every worker on a single CPU of cpus, round robin
+    std::uintmax_t maxBufferMemory = 0; // bytes of scanned content held in memory at once
+};
+
+
+// How the search is run rather than what is searched
+struct SearchOptions
+{
+    // Called periodically with the percentage of done work
+    std::function<void(short)> onProgress;
+
+    // No new files are scanned after the deadline or once cancel is set,
+    // files being scanned are abandoned between chunks and jobs
+    std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max();
+    const std::atomic<bool>* cancel = nullptr;
+
+    PerformanceOptions performance;
+
+    bool stopped() const {
+        return (cancel && *cancel) || std::chrono::steady_clock::now() >= deadline;
+    }
+};
+
+
+struct Result
+{
+    std::vector<Dependencies> dependencies;                 // by job index
+    std::vector<std::set<std::filesystem::path>> unscanned; // by job index, if stopped early; whole revisions as "<revision>:"
+    std::vector<std::filesystem::path> unreadable; // damaged archives and unknown revisions included
+    bool complete = true;
+};
+
+
+// Searches all the jobs at once: every scanned file is read once and searched
+// for all the jobs listing it. Largest files are scanned first and the huge
+// ones are split into chunks to keep all cores busy till the end.
+// Archive members are reported as "<archive>!<member>". Files of git revisions
+// are read from the object database, every distinct blob once.
+// If stopped by the deadline or cancel, the result has what was found so far,
+// the unscanned directories of the jobs are reported along with the files.
+// Throws std::invalid_argument or std::length_error if a pattern can't be compiled.
+Result FindDependencies(const std::vector<Job>& jobs, const InMemoryFiles& inMemoryFiles = {},
+                        const SearchOptions& options = {});
@@ -0,0 +1,353 @@
+#include "DepsFinderConfig.h"
+
+#include "ArchiveReader.h"
+#include "DependenciesDelta.h"
+#include "INIReader.h"
+#include "RegexDfa.h"
+
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+#include <iostream>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+using namespace std::filesystem;
+
+
+// Every [JOB.name] section is a job, keys missing in it are taken from the
+// common sections; without such sections the whole config is a single job.
+// Section names are compared ignoring case, as the rest of the .ini is.
+std::vector<Params> FetchJobs(INIReader& iniReader)
+{
+    const std::string prefix = "job.";
+    std::vector<Params> jobs;
+    for (const auto& section : iniReader.Sections())
+    {
+        if (section.size() <= prefix.size()
+            || !std::equal(prefix.begin(), prefix.end(), section.begin(), [](char p, char c) { return p == std::tolower(static_cast<unsigned char>(c)); }))
+            continue;
+        jobs.push_back(FetchParameters(iniReader, section));
+        jobs.back().name = section.substr(prefix.size());
+        jobs.back().output = iniReader.GetString(section, "Output", "dependencies." + jobs.back().name + ".txt");
+    }
+
+    if (jobs.empty())
+        jobs.push_back(FetchParameters(iniReader));
+
+    // The delta, snapshot, partial and unscanned files replace the extension of the
+    // output, so outputs differing only by it would overwrite each other too
+    std::map<path, std::string> jobByOutput;
+    for (const auto& job : jobs)
+    {
+        path stem = absolute(job.output).lexically_normal();
+        stem.replace_extension();
+        const auto [other, added] = jobByOutput.emplace(stem, job.name);
+        if (!added)
+            throw std::invalid_argument("jobs " + other->second + " and " + job.name + " write to the same output " + job.output.generic_string());
+    }
+    return jobs;
+}
+
+
+// CPU lists look like "0-3,8,10-11"; anything else leaves the CPUs unrestricted,
+// as do lists with no CPU this machine has. CPUs beyond it are dropped.
+PerformanceOptions FetchPerformance(INIReader& iniReader)
+{
+    // CPU sets of the affinity API hold 1024 CPUs, if the count is unknown
+    const unsigned machineCpus = std::thread::hardware_concurrency() > 0 ? std::thread::hardware_concurrency() : 1024;
+    const auto count = [&iniReader](const std::string& key) {
+        return static_cast<unsigned>(std::max(0L, iniReader.GetInteger("PERFORMANCE", key, 0)));
+    };
+
+    PerformanceOptions performance;
+    performance.threads = count("Threads");
+    performance.ioThreads = count("IoThreads");
+    performance.pinThreads = iniReader.GetBoolean("PERFORMANCE", "PinThreads", false);
+    performance.maxBufferMemory = static_cast<std::uintmax_t>(count("MaxBufferMemoryMB")) << 20;
+
+    for (const auto& range : iniReader.GetStringList("PERFORMANCE", "Cpus", ','))
+    {
+        unsigned first = 0, last = 0;
+        char dash = 0;
+        std::istringstream in(range);
+        if (!(in >> first) || (in >> dash && (dash != '-' || !(in >> last))) || !(in >> std::ws).eof())
+        {
+            std::cout << "Wrong CPU list, using all CPUs:\n\t" << iniReader.Get("PERFORMANCE", "Cpus", "") << "\n";
+            performance.cpus.clear();
+            break;
+        }
+        if (dash == 0)
+            last = first;
+        last = std::min(last, machineCpus - 1);
+        for (unsigned cpu = first; cpu <= last; ++cpu)
+            performance.cpus.push_back(cpu);
+    }
+    return performance;
+}
+
+
+Params FetchParameters(INIReader& iniReader, const std::string& jobSection)
+{
+    // Job sections use own key names, as paths and extentions share them
+    const auto source = [&](const std::string& jobKey, const std::string& section, const std::string& key) {
+        if (!jobSection.empty() && iniReader.HasValue(jobSection, jobKey))
+            return std::make_pair(jobSection, jobKey);
+        return std::make_pair(section, key);
+    };
+    const auto stringList = [&](const std::string& jobKey, const std::string& section, const std::string& key) {
+        const auto [s, k] = source(jobKey, section, key);
+        return iniReader.GetStringList(s, k);
+    };
+    const auto pathList = [&](const std::string& jobKey, const std::string& section, const std::string& key) {
+        const auto [s, k] = source(jobKey, section, key);
+        return iniReader.GetPathList(s, k);
+    };
+
+    Params params;
+    params.searchedDirs = pathList("SearchedPaths", "PATHS", "Searched");
+    params.scannedDirs = pathList("ScannedPaths", "PATHS", "Scanned");
+    {
+        const auto [s, k] = source("GitRepository", "GIT", "Repository");
+        params.gitRepository = iniReader.Get(s, k, "");
+    }
+    params.revisions = stringList("GitRevision", "GIT", "Revision");
+
+    for (const auto& regex : stringList("Regex", "PATTERNS", "Regex"))
+        params.searchedPatterns.emplace_back(regex, regex);
+    for (const auto& glob : stringList("Glob", "PATTERNS", "Glob"))
+        params.searchedPatterns.emplace_back(glob, RegexDfa::fromGlob(glob));
+
+    std::list<std::string> searched_extentions = stringList("SearchedExtentions", "EXTENTIONS", "Searched");
+    std::list<std::string> scanned_extentions = stringList("ScannedExtentions", "EXTENTIONS", "Scanned");
+
+    std::string searched_regStr = "(";
+    std::string scanned_regStr = "(";
+
+    for (const auto& str : searched_extentions) {
+        searched_regStr += "\\" + str + "|";
+    }
+    for (const auto& str : scanned_extentions) {
+        scanned_regStr += "\\" + str + "|";
+    }
+    searched_regStr.back() = ')';
+    scanned_regStr.back() = ')';
+
+    // Case insensitive file systems also need names and extentions to be
+    // compared ignoring case
+    {
+        const auto [s, k] = source("CaseInsensitive", "OPTIONS", "CaseInsensitive");
+        params.caseInsensitive = iniReader.GetBoolean(s, k, false);
+    }
+    {
+        const auto [s, k] = source("Engine", "OPTIONS", "Engine");
+        const std::string engine = iniReader.Get(s, k, "literal");
+        params.engine = engine == "dfa" ? MatchEngine::Dfa : engine == "token" ? MatchEngine::Token : MatchEngine::Literal;
+    }
+    {
+        const auto [s, k] = source("Delta", "OPTIONS", "Delta");
+        params.delta = iniReader.GetBoolean(s, k, false);
+    }
+    {
+        const auto [s, k] = source("Snapshot", "OPTIONS", "Snapshot");
+        params.snapshot = iniReader.GetBoolean(s, k, false);
+    }
+    {
+        const auto [s, k] = source("Archives", "OPTIONS", "Archives");
+        params.archives = iniReader.GetBoolean(s, k, false);
+    }
+
+    const auto regexFlags = params.caseInsensitive ? std::regex::ECMAScript | std::regex::icase : std::regex::ECMAScript;
+
+    params.searched_extentions_pattern = std::regex(searched_regStr, regexFlags);
+    params.scanned_extentions_pattern = std::regex(scanned_regStr, regexFlags);
+
+    return params;
+}
+
+
+std::list<path> FilterFilesByExtentions(const std::list<path>& sourceDirs, const std::regex& extentionsPattern,
+                                        const SearchOptions& options, std::set<path>* unwalked)
+{
+    std::list<path> filtered_files;
+    bool stopped = false;
+    for (const auto& sourceDir : sourceDirs)
+    {
+        if (stopped || (stopped = options.stopped()))
+        {
+            if (unwalked)
+                unwalked->insert(sourceDir);
+            continue;
+        }
+
+        if (!std::filesystem::exists(sourceDir))
+        {
+            std::cout << "Path doesn't exist:\n\t" << sourceDir << "\n";
+            continue;
+        }
+
+        recursive_directory_iterator source_it(sourceDir);
+        for (; source_it != recursive_directory_iterator(); ++source_it)
+        {
+            if ((stopped = options.stopped()))
+            {
+                if (unwalked)
+                    unwalked->insert(sourceDir);
+                break;
+            }
+
+            if (source_it->is_directory())
+                continue;
+
+            if (std::regex_match(source_it->path().extension().string(), extentionsPattern))
+            {
+                filtered_files.push_back(source_it->path());
+            }
+        }
+    }
+    return filtered_files;
+}
+
+
+std::vector<Job> MakeJobs(const std::vector<Params>& params, const SearchOptions& options)
+{
+    std::vector<Job> jobs(params.size());
+    std::map<path, std::vector<size_t>> jobsByDir;
+    for (size_t j = 0; j < params.size(); ++j)
+    {
+        jobs[j].name = params[j].name;
+        jobs[j].searchedFiles = FilterFilesByExtentions(params[j].searchedDirs, params[j].searched_extentions_pattern, options, &jobs[j].unscannedDirs);
+        jobs[j].searchedPatterns = params[j].searchedPatterns;
+        jobs[j].caseInsensitive = params[j].caseInsensitive;
+        jobs[j].engine = params[j].engine;
+        jobs[j].gitRepository = params[j].gitRepository;
+        jobs[j].scannedRevisions = params[j].revisions;
+        jobs[j].isScannedMember = [pattern = params[j].scanned_extentions_pattern](const path& member) {
+            return std::regex_match(member.extension().string(), pattern);
+        };
+        for (const auto& dir : params[j].scannedDirs)
+            jobsByDir[dir].push_back(j);
+    }
+
+    bool stopped = false;
+    for (const auto& [sourceDir, dirJobs] : jobsByDir)
+    {
+        if (stopped || (stopped = options.stopped()))
+        {
+            for (const size_t j : dirJobs)
+                jobs[j].unscannedDirs.insert(sourceDir);
+            continue;
+        }
+
+        if (!std::filesystem::exists(sourceDir))
+        {
+            std::cout << "Path doesn't exist:\n\t" << sourceDir << "\n";
+            continue;
+        }
+
+        recursive_directory_iterator source_it(sourceDir);
+        for (; source_it != recursive_directory_iterator(); ++source_it)
+        {
+            if ((stopped = options.stopped()))
+            {
+                for (const size_t j : dirJobs)
+                    jobs[j].unscannedDirs.insert(sourceDir);
+                break;
+            }
+
+            if (source_it->is_directory())
+                continue;
+
+            const std::string extention = source_it->path().extension().string();
+            const bool archive = IsArchive(source_it->path());
+            for (const size_t j : dirJobs)
+            {
+                if (archive && params[j].archives)
+                    jobs[j].scannedArchives.push_back(source_it->path());
+                else if (std::regex_match(extention, params[j].scanned_extentions_pattern))
+                    jobs[j].scannedFiles.push_back(source_it->path());
+            }
+        }
+    }
+    return jobs;
+}
+
+
+void WriteDependencies(const path& output, const Dependencies& potentialDependencies)
+{
+    std::ofstream results(output);
+    for (const auto& dep : potentialDependencies)
+    {
+        results << "Name of the file \"" << dep.first << "\" is present in file(s):";
+        for (const auto& where_ : dep.second)
+        {
+            results << "\n\t\"" << where_.generic_string();
+        }
+        results << std::endl;
+    }
+}
+
+
+// The other files replace the extension of the output: for dependencies.txt
+// the delta goes to dependencies.delta.txt and the snapshot to
+// dependencies.snapshot, the previous results are read from the snapshot if
+// it's enabled. Partial results go to dependencies.partial.txt instead, and
+// are not compared nor snapshotted, not to spoil the next delta; files they
+// miss are listed in dependencies.unscanned.txt. If the previous results
+// can't be compared the results are written without the delta.
+void WriteJobResults(const Params& params, const Dependencies& potentialDependencies, const std::set<path>& unscanned)
+{
+    path snapshotPath = params.output;
+    snapshotPath.replace_extension(".snapshot");
+    path unscannedPath = params.output;
+    unscannedPath.replace_extension(".unscanned" + params.output.extension().string());
+    path partialPath = params.output;
+    partialPath.replace_extension(".partial" + params.output.extension().string());
+
+    const bool complete = unscanned.empty();
+    std::optional<DependencyEdges> edges;
+    if (complete && (params.delta || params.snapshot))
+        edges = ToEdges(potentialDependencies);
+
+    if (params.delta && complete)
+    {
+        path deltaPath = params.output;
+        deltaPath.replace_extension(".delta" + params.output.extension().string());
+        try {
+            DependencyEdges previous;
+            if (!params.snapshot || !ReadSnapshot(snapshotPath, previous))
+            {
+                Dependencies previousDependencies;
+                ReadDependencies(params.output, previousDependencies);
+                previous = ToEdges(previousDependencies);
+            }
+
+            std::cout << "Writing changes to " << deltaPath.generic_string() << "\n";
+            WriteDependenciesDelta(deltaPath, CompareDependencies(previous, *edges));
+        }
+        catch (const std::exception& e) {
+            std::cout << "Can't compare with the previous results, no changes written:\n\t" << e.what() << "\n";
+        }
+    }
+
+    const path& resultsPath = complete ? params.output : partialPath;
+    std::cout << "Writing " << (complete ? "" : "partial ") << "results to " << resultsPath.generic_string() << "\n";
+    WriteDependencies(resultsPath, potentialDependencies);
+
+    if (params.snapshot && complete)
+        WriteSnapshot(snapshotPath, *edges);
+
+    std::error_code ec;
+    if (complete) {
+        remove(partialPath, ec);
+        remove(unscannedPath, ec);
+        return;
+    }
+
+    std::cout << "Writing " << unscanned.size() << " unscanned files to " << unscannedPath.generic_string() << "\n";
+    std::ofstream unscannedList(unscannedPath);
+    for (const auto& file : unscanned)
+        unscannedList << file.generic_string() << "\n";
+}
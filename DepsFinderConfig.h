@@ -0,0 +1,53 @@
+#pragma once
+
+#include "DepsFinder.h"
+
+#include <regex>
+
+class INIReader;
+
+
+// Parameters of one job as written in config.ini,
+// i.e. of a [JOB.*] section or of the whole config
+struct Params
+{
+    std::string name; // empty if the config has no [JOB.*] sections
+    std::filesystem::path output = "dependencies.txt";
+    std::list<std::filesystem::path> searchedDirs;
+    std::list<std::filesystem::path> scannedDirs;
+    std::list<std::pair<std::string, std::string>> searchedPatterns; // as written in .ini, as regular expression
+    std::regex searched_extentions_pattern;
+    std::regex scanned_extentions_pattern;
+    bool caseInsensitive = false;
+    MatchEngine engine = MatchEngine::Literal;
+    bool delta = false;    // also write changes since the previous run
+    bool snapshot = false; // also keep results in a binary snapshot, read instead of the text by delta
+    bool archives = false; // scan members of .tar, .tar.gz, .tgz and .zip files with scanned extentions
+    std::filesystem::path gitRepository;
+    std::list<std::string> revisions; // scanned straight from gitRepository, without a checkout
+};
+
+
+// Throws std::invalid_argument if several jobs write to the same output
+std::vector<Params> FetchJobs(INIReader& iniReader);
+
+// The [PERFORMANCE] section, common to all the jobs
+PerformanceOptions FetchPerformance(INIReader& iniReader);
+
+Params FetchParameters(INIReader& iniReader, const std::string& jobSection = "");
+
+// Stops when options.stopped(), adding the directories not walked to the end to unwalked
+std::list<std::filesystem::path> FilterFilesByExtentions(const std::list<std::filesystem::path>& sourceDirs, const std::regex& extentionsPattern,
+                                                         const SearchOptions& options = {}, std::set<std::filesystem::path>* unwalked = nullptr);
+
+// Lists searched and scanned files of the jobs, every scanned directory is
+// walked once whatever the number of jobs scanning it. Directories left when
+// options.stopped() go to unscannedDirs of the jobs.
+std::vector<Job> MakeJobs(const std::vector<Params>& params, const SearchOptions& options = {});
+
+void WriteDependencies(const std::filesystem::path& output, const Dependencies& potentialDependencies);
+
+// Writes results of the job to its output, with the delta and the snapshot if enabled;
+// results of a stopped search go to a file of their own, with the list of unscanned files,
+// leaving the output of the last complete search as it is
+void WriteJobResults(const Params& params, const Dependencies& potentialDependencies, const std::set<std::filesystem::path>& unscanned = {});
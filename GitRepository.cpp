@@ -0,0 +1,617 @@
+#include "GitRepository.h"
+
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+
+#ifdef DEPSFINDER_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+using namespace std::filesystem;
+
+
+namespace
+{
+    // Delta chains are limited by git to 50 by default, the rest is damage
+    constexpr int maxDeltaDepth = 1000;
+
+    enum PackedType
+    {
+        packedCommit = 1,
+        packedTree = 2,
+        packedBlob = 3,
+        packedTag = 4,
+        packedOffsetDelta = 6,
+        packedRefDelta = 7
+    };
+
+    GitRepository::ObjectType ObjectTypeByName(const std::string& name)
+    {
+        if (name == "blob")
+            return GitRepository::ObjectType::Blob;
+        if (name == "tree")
+            return GitRepository::ObjectType::Tree;
+        if (name == "commit")
+            return GitRepository::ObjectType::Commit;
+        if (name == "tag")
+            return GitRepository::ObjectType::Tag;
+        return GitRepository::ObjectType::None;
+    }
+
+
+    // Sizes read from object headers are not trusted with more memory than
+    // this up front, larger objects grow their buffers as they are inflated
+    constexpr std::size_t maxPresize = 4 << 20;
+
+
+    // Inflates a zlib stream read from the current position up to its end,
+    // or only its first limit bytes
+    bool Inflate(std::istream& in, std::string& out, std::size_t limit = SIZE_MAX, std::size_t sizeHint = 0)
+    {
+#ifdef DEPSFINDER_HAVE_ZLIB
+        z_stream stream{};
+        if (inflateInit(&stream) != Z_OK)
+            return false;
+
+        char input[1 << 14];
+        out.resize(std::min({ limit, maxPresize, std::max<std::size_t>(sizeHint, 256) }));
+        std::size_t produced = 0;
+        int status = Z_OK;
+        while (status != Z_STREAM_END && produced < limit)
+        {
+            if (stream.avail_in == 0) {
+                in.read(input, sizeof(input));
+                stream.next_in = reinterpret_cast<Bytef*>(input);
+                stream.avail_in = static_cast<uInt>(in.gcount());
+                if (stream.avail_in == 0)
+                    break;
+            }
+            if (produced == out.size())
+                out.resize(std::min(limit, out.size() * 2));
+            stream.next_out = reinterpret_cast<Bytef*>(&out[produced]);
+            stream.avail_out = static_cast<uInt>(std::min<std::size_t>(out.size() - produced, UINT32_MAX));
+            const uInt before = stream.avail_out;
+            status = inflate(&stream, Z_NO_FLUSH);
+            produced += before - stream.avail_out;
+            if (status != Z_OK && status != Z_STREAM_END && status != Z_BUF_ERROR)
+                break;
+        }
+        inflateEnd(&stream);
+        out.resize(produced);
+        return status == Z_STREAM_END || produced == limit;
+#else
+        (void)in;
+        (void)out;
+        (void)limit;
+        (void)sizeHint;
+        return false;
+#endif
+    }
+
+
+    // Little-endian base-128 number of delta headers
+    bool ReadDeltaSize(const std::string& delta, std::size_t& pos, std::uint64_t& size)
+    {
+        size = 0;
+        for (int shift = 0; pos < delta.size() && shift < 64; shift += 7) {
+            const auto c = static_cast<unsigned char>(delta[pos++]);
+            size |= static_cast<std::uint64_t>(c & 0x7f) << shift;
+            if (!(c & 0x80))
+                return true;
+        }
+        return false;
+    }
+
+    // Delta is a list of copies from the base and inserts of new data
+    bool ApplyDelta(const std::string& base, const std::string& delta, std::string& result)
+    {
+        std::size_t pos = 0;
+        std::uint64_t baseSize = 0, resultSize = 0;
+        if (!ReadDeltaSize(delta, pos, baseSize) || !ReadDeltaSize(delta, pos, resultSize) || baseSize != base.size())
+            return false;
+
+        result.clear();
+        result.reserve(static_cast<std::size_t>(std::min<std::uint64_t>(resultSize, maxPresize)));
+        while (pos < delta.size())
+        {
+            const auto op = static_cast<unsigned char>(delta[pos++]);
+            if (op & 0x80) {
+                std::uint64_t offset = 0, size = 0;
+                for (int i = 0; i < 4; ++i)
+                    if (op & (1 << i)) {
+                        if (pos == delta.size())
+                            return false;
+                        offset |= static_cast<std::uint64_t>(static_cast<unsigned char>(delta[pos++])) << (8 * i);
+                    }
+                for (int i = 0; i < 3; ++i)
+                    if (op & (0x10 << i)) {
+                        if (pos == delta.size())
+                            return false;
+                        size |= static_cast<std::uint64_t>(static_cast<unsigned char>(delta[pos++])) << (8 * i);
+                    }
+                if (size == 0)
+                    size = 0x10000;
+                if (offset + size > base.size())
+                    return false;
+                result.append(base, static_cast<std::size_t>(offset), static_cast<std::size_t>(size));
+            } else if (op != 0) {
+                if (pos + op > delta.size())
+                    return false;
+                result.append(delta, pos, op);
+                pos += op;
+            } else {
+                return false;
+            }
+            // repeated copies could otherwise blow a small delta up without end
+            if (result.size() > resultSize)
+                return false;
+        }
+        return result.size() == resultSize;
+    }
+
+
+    // Type and size of a packed object, big-endian base-128 after the type bits
+    bool ReadPackedHeader(std::istream& in, int& type, std::uint64_t& size)
+    {
+        int c = in.get();
+        if (c == EOF)
+            return false;
+        type = (c >> 4) & 7;
+        size = c & 0x0f;
+        for (int shift = 4; c & 0x80; shift += 7) {
+            if ((c = in.get()) == EOF || shift > 57)
+                return false;
+            size |= static_cast<std::uint64_t>(c & 0x7f) << shift;
+        }
+        return true;
+    }
+
+    // Distance back to the base of an offset delta
+    bool ReadBaseDistance(std::istream& in, std::uint64_t& distance)
+    {
+        int c = in.get();
+        if (c == EOF)
+            return false;
+        distance = c & 0x7f;
+        while (c & 0x80) {
+            if ((c = in.get()) == EOF || distance >> 56)
+                return false;
+            distance = ((distance + 1) << 7) | (c & 0x7f);
+        }
+        return true;
+    }
+
+    std::uint32_t BigEndian32(const unsigned char* p)
+    {
+        return static_cast<std::uint32_t>(p[0]) << 24 | static_cast<std::uint32_t>(p[1]) << 16
+             | static_cast<std::uint32_t>(p[2]) << 8 | static_cast<std::uint32_t>(p[3]);
+    }
+
+    std::string ReadFirstLine(const path& file)
+    {
+        std::ifstream in(file);
+        std::string line;
+        std::getline(in, line);
+        while (!line.empty() && (line.back() == '\r' || line.back() == ' '))
+            line.pop_back();
+        return line;
+    }
+}
+
+
+GitRepository::GitRepository(const path& repository)
+{
+    // A work tree has .git either as a directory or as a file pointing to it
+    std::error_code ec;
+    m_gitDir = repository;
+    if (is_directory(repository / ".git", ec)) {
+        m_gitDir = repository / ".git";
+    } else if (is_regular_file(repository / ".git", ec)) {
+        const std::string link = ReadFirstLine(repository / ".git");
+        if (link.rfind("gitdir: ", 0) == 0)
+            m_gitDir = repository / link.substr(8);
+    }
+
+    // Linked work trees keep objects and most refs in the main repository
+    m_commonDir = m_gitDir;
+    if (exists(m_gitDir / "commondir", ec))
+        m_commonDir = m_gitDir / ReadFirstLine(m_gitDir / "commondir");
+
+    // Pack indexes, version 2: magic, version, fanout table, sorted ids,
+    // CRCs, 31-bit offsets with the high bit pointing into 64-bit offsets
+    const path packDir = m_commonDir / "objects" / "pack";
+    if (!is_directory(packDir, ec))
+        return;
+    for (const auto& entry : directory_iterator(packDir, ec))
+    {
+        if (entry.path().extension() != ".idx")
+            continue;
+
+        std::ifstream idxFile(entry.path(), std::ios::binary);
+        const std::string idx((std::istreambuf_iterator<char>(idxFile)), std::istreambuf_iterator<char>());
+        const auto* data = reinterpret_cast<const unsigned char*>(idx.data());
+        constexpr std::size_t headerSize = 8 + 256 * 4;
+        if (idx.size() < headerSize || BigEndian32(data) != 0xff744f63 || BigEndian32(data + 4) != 2)
+            continue;
+
+        const std::size_t count = BigEndian32(data + 8 + 255 * 4);
+        const std::size_t idsAt = headerSize;
+        const std::size_t offsetsAt = idsAt + count * 24;
+        const std::size_t largeOffsetsAt = offsetsAt + count * 4;
+        if (idx.size() < largeOffsetsAt)
+            continue;
+
+        Pack pack;
+        pack.file = entry.path();
+        pack.file.replace_extension(".pack");
+        pack.ids.resize(count);
+        pack.offsets.resize(count);
+        bool intact = true;
+        for (std::size_t i = 0; i < count && intact; ++i)
+        {
+            std::copy_n(data + idsAt + i * 20, 20, pack.ids[i].begin());
+            const std::uint32_t offset = BigEndian32(data + offsetsAt + i * 4);
+            if (!(offset & 0x80000000)) {
+                pack.offsets[i] = offset;
+                continue;
+            }
+            const std::size_t large = largeOffsetsAt + (offset & 0x7fffffff) * std::size_t(8);
+            if (large + 8 > idx.size()) {
+                intact = false;
+                continue;
+            }
+            pack.offsets[i] = static_cast<std::uint64_t>(BigEndian32(data + large)) << 32 | BigEndian32(data + large + 4);
+        }
+        if (intact)
+            m_packs.push_back(std::move(pack));
+    }
+}
+
+
+bool GitRepository::valid() const
+{
+    std::error_code ec;
+    return is_directory(m_commonDir / "objects", ec);
+}
+
+
+std::string GitRepository::toHex(const GitObjectId& id)
+{
+    static const char digits[] = "0123456789abcdef";
+    std::string hex;
+    for (const unsigned char byte : id) {
+        hex += digits[byte >> 4];
+        hex += digits[byte & 0x0f];
+    }
+    return hex;
+}
+
+
+std::optional<GitObjectId> GitRepository::fromHex(const std::string& hex)
+{
+    const auto digit = [](char c) {
+        if (c >= '0' && c <= '9')
+            return c - '0';
+        if (c >= 'a' && c <= 'f')
+            return c - 'a' + 10;
+        if (c >= 'A' && c <= 'F')
+            return c - 'A' + 10;
+        return -1;
+    };
+
+    if (hex.size() != 40)
+        return std::nullopt;
+    GitObjectId id;
+    for (std::size_t i = 0; i < id.size(); ++i) {
+        const int high = digit(hex[2 * i]);
+        const int low = digit(hex[2 * i + 1]);
+        if (high < 0 || low < 0)
+            return std::nullopt;
+        id[i] = static_cast<unsigned char>(high << 4 | low);
+    }
+    return id;
+}
+
+
+std::optional<GitRepository::Location> GitRepository::locate(const GitObjectId& id) const
+{
+    for (const auto& pack : m_packs) {
+        const auto found = std::lower_bound(pack.ids.begin(), pack.ids.end(), id);
+        if (found != pack.ids.end() && *found == id)
+            return Location{ &pack, pack.offsets[found - pack.ids.begin()] };
+    }
+
+    const std::string hex = toHex(id);
+    std::error_code ec;
+    if (exists(m_commonDir / "objects" / hex.substr(0, 2) / hex.substr(2), ec))
+        return Location{};
+    return std::nullopt;
+}
+
+
+// Loose object: zlib of "<type> <size>\0<content>"
+bool GitRepository::readLoose(const GitObjectId& id, std::string& content, ObjectType& type, std::size_t limit) const
+{
+    const std::string hex = toHex(id);
+    std::ifstream in(m_commonDir / "objects" / hex.substr(0, 2) / hex.substr(2), std::ios::binary);
+    std::string raw;
+    if (!in.is_open() || !Inflate(in, raw, limit))
+        return false;
+
+    const std::size_t space = raw.find(' ');
+    const std::size_t end = raw.find('\0');
+    if (space == std::string::npos || end == std::string::npos || space > end)
+        return false;
+    type = ObjectTypeByName(raw.substr(0, space));
+    content = raw.substr(end + 1);
+    return type != ObjectType::None;
+}
+
+
+bool GitRepository::readPacked(const Pack& pack, std::uint64_t offset, std::string& content, ObjectType& type, int depth) const
+{
+    if (depth > maxDeltaDepth)
+        return false;
+
+    std::ifstream in(pack.file, std::ios::binary);
+    int packedType = 0;
+    std::uint64_t size = 0;
+    if (!in.is_open() || !in.seekg(static_cast<std::streamoff>(offset)) || !ReadPackedHeader(in, packedType, size))
+        return false;
+
+    switch (packedType) {
+    case packedCommit:
+    case packedTree:
+    case packedBlob:
+    case packedTag:
+        type = packedType == packedCommit ? ObjectType::Commit
+             : packedType == packedTree ? ObjectType::Tree
+             : packedType == packedBlob ? ObjectType::Blob : ObjectType::Tag;
+        return Inflate(in, content, SIZE_MAX, static_cast<std::size_t>(size)) && content.size() == size;
+    case packedOffsetDelta:
+    case packedRefDelta:
+        break;
+    default:
+        return false;
+    }
+
+    std::optional<Location> base;
+    if (packedType == packedOffsetDelta) {
+        std::uint64_t distance = 0;
+        if (!ReadBaseDistance(in, distance) || distance > offset)
+            return false;
+        base = Location{ &pack, offset - distance };
+    } else {
+        GitObjectId baseId;
+        if (!in.read(reinterpret_cast<char*>(baseId.data()), baseId.size()) || !(base = locate(baseId)))
+            return false;
+        if (!base->pack) {
+            std::string delta, baseContent;
+            return Inflate(in, delta, SIZE_MAX, static_cast<std::size_t>(size))
+                && readLoose(baseId, baseContent, type, SIZE_MAX) && ApplyDelta(baseContent, delta, content);
+        }
+    }
+
+    std::string delta;
+    if (!Inflate(in, delta, SIZE_MAX, static_cast<std::size_t>(size)))
+        return false;
+
+    const auto key = std::make_pair(base->pack, base->offset);
+    std::shared_ptr<const std::string> baseContent;
+    {
+        std::lock_guard<std::mutex> lock(m_cacheMutex);
+        const auto cached = m_baseCache.find(key);
+        if (cached != m_baseCache.end()) {
+            type = cached->second.type;
+            baseContent = cached->second.content;
+            m_baseCacheUse.splice(m_baseCacheUse.begin(), m_baseCacheUse, cached->second.use);
+        }
+    }
+    if (!baseContent) {
+        auto read = std::make_shared<std::string>();
+        if (!readPacked(*base->pack, base->offset, *read, type, depth + 1))
+            return false;
+        baseContent = read;
+
+        std::lock_guard<std::mutex> lock(m_cacheMutex);
+        if (read->size() <= m_baseCacheLimit && m_baseCache.count(key) == 0) {
+            while (m_baseCacheSize + read->size() > m_baseCacheLimit) {
+                const auto evicted = m_baseCache.find(m_baseCacheUse.back());
+                m_baseCacheSize -= evicted->second.content->size();
+                m_baseCache.erase(evicted);
+                m_baseCacheUse.pop_back();
+            }
+            m_baseCacheUse.push_front(key);
+            m_baseCache.emplace(key, CachedBase{ type, baseContent, m_baseCacheUse.begin() });
+            m_baseCacheSize += read->size();
+        }
+    }
+    return ApplyDelta(*baseContent, delta, content);
+}
+
+
+bool GitRepository::read(const GitObjectId& id, std::string& content, ObjectType* type) const
+{
+    ObjectType objectType = ObjectType::None;
+    const auto location = locate(id);
+    const bool done = location && (location->pack ? readPacked(*location->pack, location->offset, content, objectType)
+                                                   : readLoose(id, content, objectType, SIZE_MAX));
+    if (type)
+        *type = objectType;
+    return done;
+}
+
+
+std::uintmax_t GitRepository::size(const GitObjectId& id) const
+{
+    const auto location = locate(id);
+    if (!location)
+        return 0;
+
+    if (!location->pack) {
+        const std::string hex = toHex(id);
+        std::ifstream in(m_commonDir / "objects" / hex.substr(0, 2) / hex.substr(2), std::ios::binary);
+        std::string header;
+        Inflate(in, header, 32);
+        const std::size_t space = header.find(' ');
+        return space == std::string::npos ? 0 : std::strtoull(header.c_str() + space + 1, nullptr, 10);
+    }
+
+    // a delta starts with sizes of its base and of the result
+    std::ifstream in(location->pack->file, std::ios::binary);
+    int packedType = 0;
+    std::uint64_t size = 0;
+    if (!in.seekg(static_cast<std::streamoff>(location->offset)) || !ReadPackedHeader(in, packedType, size))
+        return 0;
+    if (packedType != packedOffsetDelta && packedType != packedRefDelta)
+        return size;
+
+    std::uint64_t distance = 0;
+    GitObjectId baseId;
+    if (packedType == packedOffsetDelta ? !ReadBaseDistance(in, distance) : !in.read(reinterpret_cast<char*>(baseId.data()), baseId.size()))
+        return 0;
+    std::string delta;
+    std::size_t pos = 0;
+    std::uint64_t baseSize = 0;
+    Inflate(in, delta, 20);
+    return ReadDeltaSize(delta, pos, baseSize) && ReadDeltaSize(delta, pos, size) ? size : 0;
+}
+
+
+// A ref file holds either an id or "ref: <other ref>", refs may also be packed
+std::optional<GitObjectId> GitRepository::resolveRef(const std::string& ref, int depth) const
+{
+    if (depth > 10)
+        return std::nullopt;
+
+    std::error_code ec;
+    for (const auto& dir : { m_gitDir, m_commonDir }) {
+        if (!is_regular_file(dir / ref, ec))
+            continue;
+        const std::string line = ReadFirstLine(dir / ref);
+        if (line.rfind("ref: ", 0) == 0)
+            return resolveRef(line.substr(5), depth + 1);
+        return fromHex(line.substr(0, 40));
+    }
+
+    std::ifstream packedRefs(m_commonDir / "packed-refs");
+    std::string line;
+    while (std::getline(packedRefs, line)) {
+        if (line.empty() || line[0] == '#' || line[0] == '^')
+            continue;
+        while (!line.empty() && line.back() == '\r')
+            line.pop_back();
+        if (line.size() > 41 && line.compare(41, std::string::npos, ref) == 0)
+            return fromHex(line.substr(0, 40));
+    }
+    return std::nullopt;
+}
+
+
+// Abbreviated ids must match a single object
+std::optional<GitObjectId> GitRepository::resolvePrefix(const std::string& hexPrefix) const
+{
+    std::string prefix = hexPrefix;
+    std::transform(prefix.begin(), prefix.end(), prefix.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+
+    std::vector<GitObjectId> matches;
+    const auto smallest = fromHex(prefix + std::string(40 - prefix.size(), '0'));
+    if (!smallest)
+        return std::nullopt;
+    for (const auto& pack : m_packs)
+        for (auto id = std::lower_bound(pack.ids.begin(), pack.ids.end(), *smallest);
+             id != pack.ids.end() && toHex(*id).compare(0, prefix.size(), prefix) == 0; ++id)
+            matches.push_back(*id);
+
+    std::error_code ec;
+    const path looseDir = m_commonDir / "objects" / prefix.substr(0, 2);
+    if (is_directory(looseDir, ec))
+        for (const auto& entry : directory_iterator(looseDir, ec)) {
+            const std::string rest = entry.path().filename().string();
+            if (rest.compare(0, prefix.size() - 2, prefix, 2, std::string::npos) == 0)
+                if (const auto id = fromHex(prefix.substr(0, 2) + rest))
+                    matches.push_back(*id);
+        }
+
+    std::sort(matches.begin(), matches.end());
+    matches.erase(std::unique(matches.begin(), matches.end()), matches.end());
+    if (matches.size() != 1)
+        return std::nullopt;
+    return matches.front();
+}
+
+
+std::optional<GitObjectId> GitRepository::resolveTree(const std::string& revision) const
+{
+    // the same order of refs as git rev-parse looks them up in
+    std::optional<GitObjectId> id = fromHex(revision);
+    for (const std::string& ref : { revision, "refs/" + revision, "refs/tags/" + revision, "refs/heads/" + revision,
+                                    "refs/remotes/" + revision, "refs/remotes/" + revision + "/HEAD" }) {
+        if (id)
+            break;
+        if (ref.find("..") == std::string::npos)
+            id = resolveRef(ref);
+    }
+    const bool hex = revision.size() >= 4 && revision.size() < 40
+        && std::all_of(revision.begin(), revision.end(), [](unsigned char c) { return std::isxdigit(c); });
+    if (!id && hex)
+        id = resolvePrefix(revision);
+
+    // tags point to commits or other tags, commits to trees
+    for (int depth = 0; id && depth < 10; ++depth) {
+        std::string content;
+        ObjectType type = ObjectType::None;
+        if (!read(*id, content, &type))
+            return std::nullopt;
+        if (type == ObjectType::Tree)
+            return id;
+        if (type == ObjectType::Commit && content.rfind("tree ", 0) == 0)
+            id = fromHex(content.substr(5, 40));
+        else if (type == ObjectType::Tag && content.rfind("object ", 0) == 0)
+            id = fromHex(content.substr(7, 40));
+        else
+            return std::nullopt;
+    }
+    return std::nullopt;
+}
+
+
+bool GitRepository::listTree(const GitObjectId& tree, const std::function<void(const std::string& path, const GitObjectId& blob)>& onBlob) const
+{
+    return listTree(tree, "", onBlob);
+}
+
+
+// Tree entries are "<octal mode> <name>\0<20-byte id>"; submodules and
+// symbolic links are not files of this repository
+bool GitRepository::listTree(const GitObjectId& tree, const std::string& prefix,
+                             const std::function<void(const std::string&, const GitObjectId&)>& onBlob) const
+{
+    std::string content;
+    ObjectType type = ObjectType::None;
+    if (!read(tree, content, &type) || type != ObjectType::Tree)
+        return false;
+
+    bool intact = true;
+    std::size_t pos = 0;
+    while (pos < content.size())
+    {
+        const std::size_t space = content.find(' ', pos);
+        const std::size_t end = content.find('\0', pos);
+        if (space == std::string::npos || end == std::string::npos || space > end || end + 21 > content.size())
+            return false;
+
+        const std::string mode = content.substr(pos, space - pos);
+        const std::string name = prefix + content.substr(space + 1, end - space - 1);
+        GitObjectId id;
+        std::copy_n(reinterpret_cast<const unsigned char*>(content.data()) + end + 1, id.size(), id.begin());
+        pos = end + 21;
+
+        if (mode == "40000")
+            intact = listTree(id, name + "/", onBlob) && intact;
+        else if (mode != "160000" && mode != "120000")
+            onBlob(name, id);
+    }
+    return intact;
+}
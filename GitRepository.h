@@ -0,0 +1,99 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+
+using GitObjectId = std::array<unsigned char, 20>;
+
+
+// Minimal read-only access to the object database of a local git repository:
+// loose objects and pack files (index v2, offset and ref deltas), resolved
+// without a checkout or libgit2. Needs zlib, without it nothing can be read.
+class GitRepository
+{
+public:
+    enum class ObjectType
+    {
+        None,
+        Commit,
+        Tree,
+        Blob,
+        Tag
+    };
+
+    // Either a work tree with .git in it or a .git or bare repository directory
+    explicit GitRepository(const std::filesystem::path& repository);
+
+    bool valid() const;
+
+    // Finds the tree of a full or abbreviated commit id, HEAD, branch, tag or
+    // any other ref; annotated tags are peeled
+    std::optional<GitObjectId> resolveTree(const std::string& revision) const;
+
+    // Calls onBlob for every regular file of the tree and its subtrees, paths are
+    // relative to the tree; returns false if a subtree couldn't be read
+    bool listTree(const GitObjectId& tree, const std::function<void(const std::string& path, const GitObjectId& blob)>& onBlob) const;
+
+    // Reads the content of an object, may be called from several threads
+    bool read(const GitObjectId& id, std::string& content, ObjectType* type = nullptr) const;
+
+    // Size of the object content read from its header only, 0 if unknown
+    std::uintmax_t size(const GitObjectId& id) const;
+
+    // Delta bases kept for reuse take up to this many bytes, 64MB by default
+    void setBaseCacheLimit(std::size_t bytes) { m_baseCacheLimit = bytes; }
+
+    static std::string toHex(const GitObjectId& id);
+    static std::optional<GitObjectId> fromHex(const std::string& hex);
+
+private:
+    struct Pack
+    {
+        std::filesystem::path file;
+        std::vector<GitObjectId> ids; // sorted, as in the index
+        std::vector<std::uint64_t> offsets;
+    };
+
+    struct Location
+    {
+        const Pack* pack = nullptr; // loose object if null
+        std::uint64_t offset = 0;
+    };
+
+    std::optional<Location> locate(const GitObjectId& id) const;
+    std::optional<GitObjectId> resolveRef(const std::string& ref, int depth = 0) const;
+    std::optional<GitObjectId> resolvePrefix(const std::string& hexPrefix) const;
+    bool readLoose(const GitObjectId& id, std::string& content, ObjectType& type, std::size_t limit) const;
+    bool readPacked(const Pack& pack, std::uint64_t offset, std::string& content, ObjectType& type, int depth = 0) const;
+    bool listTree(const GitObjectId& tree, const std::string& prefix,
+                  const std::function<void(const std::string&, const GitObjectId&)>& onBlob) const;
+
+    std::filesystem::path m_gitDir;    // HEAD and worktree specific refs
+    std::filesystem::path m_commonDir; // objects and shared refs
+    std::vector<Pack> m_packs;
+
+    // Recently used delta bases, consecutive blobs of a pack tend to share them;
+    // the least recently used ones are evicted first
+    using BaseKey = std::pair<const Pack*, std::uint64_t>;
+    struct CachedBase
+    {
+        ObjectType type = ObjectType::None;
+        std::shared_ptr<const std::string> content;
+        std::list<BaseKey>::iterator use;
+    };
+    mutable std::mutex m_cacheMutex;
+    mutable std::map<BaseKey, CachedBase> m_baseCache;
+    mutable std::list<BaseKey> m_baseCacheUse; // most recently used first
+    mutable std::size_t m_baseCacheSize = 0;
+    std::size_t m_baseCacheLimit = 64 << 20;
+};
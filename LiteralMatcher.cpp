@@ -0,0 +1,124 @@
+#include "LiteralMatcher.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+
+
+LiteralMatcher::LiteralMatcher(std::vector<std::string> names, bool caseInsensitive)
+    : m_names(std::move(names))
+    , m_fingerprints(caseInsensitive)
+    , m_caseInsensitive(caseInsensitive)
+{
+    for (size_t i = 0; i < m_names.size(); ++i)
+    {
+        std::string& name = m_names[i];
+        if (m_caseInsensitive)
+            for (auto& c : name)
+                c = static_cast<char>(FoldAsciiCase(static_cast<unsigned char>(c)));
+        m_maxLength = std::max(m_maxLength, name.size());
+
+        if (name.size() < 2) {
+            if (!name.empty())
+                m_tinyNames.push_back(i);
+            continue;
+        }
+
+        const auto first = static_cast<unsigned char>(name[name.size() - 2]);
+        const auto second = static_cast<unsigned char>(name[name.size() - 1]);
+        m_fingerprints.insert(first, second);
+
+        Bucket& bucket = m_buckets[static_cast<uint16_t>(first << 8 | second)];
+        if (name.size() >= 4)
+            bucket.byTail[tailKey(name.data() + name.size())].push_back(i);
+        else
+            bucket.shortNames.push_back(i);
+    }
+}
+
+
+void LiteralMatcher::search(std::string_view text, std::vector<bool>& found) const
+{
+    for (const size_t i : m_tinyNames) {
+        const char c = m_names[i][0];
+        const char other = m_caseInsensitive ? static_cast<char>(std::toupper(static_cast<unsigned char>(c))) : c;
+        if (!found[i] && text.find_first_of(std::string{ c, other }) != std::string_view::npos)
+            found[i] = true;
+    }
+
+    if (m_fingerprints.empty())
+        return;
+
+    // Candidates are collected window by window to keep the buffer small;
+    // windows overlap by one byte so that no pair is lost on their border
+    constexpr size_t windowSize = 1 << 16;
+    std::vector<size_t> candidates;
+    for (size_t windowBegin = 0; windowBegin + 1 < text.size(); windowBegin += windowSize)
+    {
+        const size_t windowLength = std::min(windowSize + 1, text.size() - windowBegin);
+        candidates.clear();
+        m_fingerprints.findCandidates(text.data() + windowBegin, windowLength, candidates);
+
+        for (const size_t candidate : candidates)
+        {
+            const size_t end = windowBegin + candidate + 2;
+            auto first = static_cast<unsigned char>(text[end - 2]);
+            auto second = static_cast<unsigned char>(text[end - 1]);
+            if (m_caseInsensitive) {
+                first = FoldAsciiCase(first);
+                second = FoldAsciiCase(second);
+            }
+            verify(text, end, m_buckets.at(static_cast<uint16_t>(first << 8 | second)), found);
+        }
+    }
+}
+
+
+uint32_t LiteralMatcher::tailKey(const char* end) const
+{
+    unsigned char tail[4];
+    std::memcpy(tail, end - 4, sizeof(tail));
+    if (m_caseInsensitive)
+        for (auto& c : tail)
+            c = FoldAsciiCase(c);
+
+    uint32_t key;
+    std::memcpy(&key, tail, sizeof(key));
+    return key;
+}
+
+
+bool LiteralMatcher::equals(const char* text, const std::string& name) const
+{
+    if (!m_caseInsensitive)
+        return std::memcmp(text, name.data(), name.size()) == 0;
+
+    for (size_t i = 0; i < name.size(); ++i)
+        if (FoldAsciiCase(static_cast<unsigned char>(text[i])) != static_cast<unsigned char>(name[i]))
+            return false;
+    return true;
+}
+
+
+// Compares the names of the bucket with the text ending at the given position
+void LiteralMatcher::verify(std::string_view text, size_t end, const Bucket& bucket, std::vector<bool>& found) const
+{
+    const auto matches = [&](size_t i) {
+        const std::string& name = m_names[i];
+        return !found[i] && name.size() <= end && equals(text.data() + end - name.size(), name);
+    };
+
+    for (const size_t i : bucket.shortNames)
+        if (matches(i))
+            found[i] = true;
+
+    if (end < 4 || bucket.byTail.empty())
+        return;
+
+    const auto sameTail = bucket.byTail.find(tailKey(text.data() + end));
+    if (sameTail == bucket.byTail.end())
+        return;
+    for (const size_t i : sameTail->second)
+        if (matches(i))
+            found[i] = true;
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include "BytePairSet.h"
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+
+// Finds which of the searched names occur in a text as plain substrings.
+// The last two bytes of every name form a fingerprint, positions of the
+// fingerprints are found by BytePairSet, and only there names are compared.
+// With caseInsensitive names are compared ignoring ASCII case.
+class LiteralMatcher
+{
+public:
+    explicit LiteralMatcher(std::vector<std::string> names, bool caseInsensitive = false);
+
+    // Names as they are compared, i.e. lowercased if case insensitive
+    const std::vector<std::string>& names() const { return m_names; }
+
+    // Length of the longest name, i.e. the overlap needed between chunks
+    size_t maxLength() const { return m_maxLength; }
+
+    // Sets found[i] for every names()[i] present in the text,
+    // found must be sized as names()
+    void search(std::string_view text, std::vector<bool>& found) const;
+
+private:
+    // Names sharing the same last two bytes
+    struct Bucket
+    {
+        std::unordered_map<uint32_t, std::vector<size_t>> byTail; // names of 4+ bytes by last 4 bytes
+        std::vector<size_t> shortNames;
+    };
+
+    uint32_t tailKey(const char* end) const;
+
+    bool equals(const char* text, const std::string& name) const;
+
+    void verify(std::string_view text, size_t end, const Bucket& bucket, std::vector<bool>& found) const;
+
+    std::vector<std::string> m_names;
+    std::vector<size_t> m_tinyNames; // names of a single byte, no fingerprint
+    std::unordered_map<uint16_t, Bucket> m_buckets;
+    BytePairSet m_fingerprints;
+    size_t m_maxLength = 0;
+    bool m_caseInsensitive;
+};
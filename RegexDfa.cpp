@@ -0,0 +1,607 @@
+#include "RegexDfa.h"
+
+#include <algorithm>
+#include <bitset>
+#include <cctype>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <unordered_map>
+
+
+namespace
+{
+    constexpr size_t maxDfaStates = 1 << 17;
+    constexpr size_t maxRepetitions = 1000;
+
+    using ByteSet = std::bitset<256>;
+
+    struct Node;
+    using NodePtr = std::shared_ptr<const Node>;
+
+    // Parsed pattern, subtrees may be shared as compiling never changes them
+    struct Node
+    {
+        enum Kind { Empty, Set, Concat, Alt, Star } kind;
+        ByteSet set;
+        std::vector<NodePtr> children;
+    };
+
+    NodePtr makeNode(Node::Kind kind, std::vector<NodePtr> children = {}) {
+        return std::make_shared<const Node>(Node{ kind, {}, std::move(children) });
+    }
+
+    NodePtr makeSet(const ByteSet& set) {
+        return std::make_shared<const Node>(Node{ Node::Set, set, {} });
+    }
+
+    int firstByte(const ByteSet& set) {
+        for (int b = 0; b < 256; ++b)
+            if (set[b])
+                return b;
+        return -1;
+    }
+
+    size_t maxLength(const Node& node) {
+        switch (node.kind) {
+        case Node::Empty: return 0;
+        case Node::Set: return 1;
+        case Node::Star: return maxLength(*node.children.front()) == 0 ? 0 : RegexDfa::unbounded;
+        case Node::Concat: {
+            size_t sum = 0;
+            for (const auto& child : node.children) {
+                const size_t length = maxLength(*child);
+                if (length == RegexDfa::unbounded)
+                    return RegexDfa::unbounded;
+                sum += length;
+            }
+            return sum;
+        }
+        case Node::Alt: {
+            size_t longest = 0;
+            for (const auto& child : node.children)
+                longest = std::max(longest, maxLength(*child));
+            return longest;
+        }
+        }
+        return 0;
+    }
+
+
+    // Recursive descent parser of a single pattern
+    class Parser
+    {
+    public:
+        Parser(std::string_view pattern, bool caseInsensitive)
+            : m_pattern(pattern), m_caseInsensitive(caseInsensitive) {}
+
+        NodePtr parse() {
+            NodePtr result = parseAlternation();
+            if (m_pos != m_pattern.size())
+                fail("unbalanced ')'");
+            return result;
+        }
+
+    private:
+        [[noreturn]] void fail(const std::string& what) const {
+            throw std::invalid_argument("Pattern \"" + std::string(m_pattern) + "\": " + what);
+        }
+
+        bool atEnd() const { return m_pos >= m_pattern.size(); }
+        char peek() const { return m_pattern[m_pos]; }
+
+        NodePtr parseAlternation() {
+            std::vector<NodePtr> branches{ parseConcatenation() };
+            while (!atEnd() && peek() == '|') {
+                ++m_pos;
+                branches.push_back(parseConcatenation());
+            }
+            return branches.size() == 1 ? branches.front() : makeNode(Node::Alt, std::move(branches));
+        }
+
+        NodePtr parseConcatenation() {
+            std::vector<NodePtr> items;
+            while (!atEnd() && peek() != '|' && peek() != ')')
+                items.push_back(parseRepetition());
+            if (items.empty())
+                return makeNode(Node::Empty);
+            return items.size() == 1 ? items.front() : makeNode(Node::Concat, std::move(items));
+        }
+
+        NodePtr parseRepetition() {
+            NodePtr atom = parseAtom();
+            while (!atEnd()) {
+                size_t min = 0, max = 0;
+                const char c = peek();
+                if (c == '*') {
+                    min = 0; max = RegexDfa::unbounded;
+                } else if (c == '+') {
+                    min = 1; max = RegexDfa::unbounded;
+                } else if (c == '?') {
+                    min = 0; max = 1;
+                } else if (c != '{' || !parseBounds(min, max)) {
+                    break;
+                }
+                if (c != '{')
+                    ++m_pos;
+                // lazy quantifiers find the same occurrences
+                if (!atEnd() && peek() == '?')
+                    ++m_pos;
+                atom = repeat(atom, min, max);
+            }
+            return atom;
+        }
+
+        // Parses {m}, {m,} or {m,n}, leaves '{' as a literal if it isn't one
+        bool parseBounds(size_t& min, size_t& max) {
+            size_t pos = m_pos + 1;
+            const auto number = [&](size_t& value) {
+                const size_t begin = pos;
+                value = 0;
+                while (pos < m_pattern.size() && std::isdigit(static_cast<unsigned char>(m_pattern[pos])))
+                    value = std::min(value * 10 + (m_pattern[pos++] - '0'), maxRepetitions + 1);
+                return pos > begin;
+            };
+            if (!number(min))
+                return false;
+            max = min;
+            if (pos < m_pattern.size() && m_pattern[pos] == ',') {
+                ++pos;
+                if (!number(max))
+                    max = RegexDfa::unbounded;
+            }
+            if (pos >= m_pattern.size() || m_pattern[pos] != '}')
+                return false;
+            if (min > maxRepetitions || (max != RegexDfa::unbounded && max > maxRepetitions))
+                fail("too many repetitions");
+            if (max < min)
+                fail("invalid repetition bounds");
+            m_pos = pos + 1;
+            return true;
+        }
+
+        NodePtr repeat(const NodePtr& atom, size_t min, size_t max) {
+            std::vector<NodePtr> items(min, atom);
+            if (max == RegexDfa::unbounded) {
+                items.push_back(makeNode(Node::Star, { atom }));
+            } else {
+                // x{0,n-m} as (x(x(...)?)?)?
+                NodePtr optional;
+                for (size_t i = min; i < max; ++i) {
+                    std::vector<NodePtr> inner{ atom };
+                    if (optional)
+                        inner.push_back(optional);
+                    optional = makeNode(Node::Alt, { makeNode(Node::Concat, std::move(inner)), makeNode(Node::Empty) });
+                }
+                if (optional)
+                    items.push_back(optional);
+            }
+            if (items.empty())
+                return makeNode(Node::Empty);
+            return items.size() == 1 ? items.front() : makeNode(Node::Concat, std::move(items));
+        }
+
+        NodePtr parseAtom() {
+            const char c = m_pattern[m_pos++];
+            switch (c) {
+            case '(': {
+                if (m_pattern.substr(m_pos, 2) == "?:")
+                    m_pos += 2;
+                else if (!atEnd() && peek() == '?')
+                    fail("lookarounds are not supported");
+                NodePtr group = parseAlternation();
+                if (atEnd() || peek() != ')')
+                    fail("missing ')'");
+                ++m_pos;
+                return group;
+            }
+            case '[':
+                return makeSet(parseClass());
+            case '.': {
+                ByteSet set;
+                set.set();
+                set.reset('\n');
+                set.reset('\r');
+                return makeSet(set);
+            }
+            case '\\':
+                return makeSet(fold(parseEscape()));
+            case '^':
+            case '$':
+                fail("anchors are not supported");
+            case '*':
+            case '+':
+            case '?':
+                fail("nothing to repeat");
+            default: {
+                ByteSet set;
+                set.set(static_cast<unsigned char>(c));
+                return makeSet(fold(set));
+            }
+            }
+        }
+
+        ByteSet parseEscape() {
+            if (atEnd())
+                fail("trailing '\\'");
+            const char c = m_pattern[m_pos++];
+            ByteSet set;
+            const auto addIf = [&set](int (*predicate)(int)) {
+                for (int b = 0; b < 128; ++b)
+                    if (predicate(b))
+                        set.set(b);
+            };
+            switch (c) {
+            case 'd': addIf([](int b) { return int(std::isdigit(b) != 0); }); break;
+            case 'w': addIf([](int b) { return int(std::isalnum(b) != 0 || b == '_'); }); break;
+            case 's': addIf([](int b) { return int(std::isspace(b) != 0); }); break;
+            case 'D': addIf([](int b) { return int(std::isdigit(b) != 0); }); set.flip(); break;
+            case 'W': addIf([](int b) { return int(std::isalnum(b) != 0 || b == '_'); }); set.flip(); break;
+            case 'S': addIf([](int b) { return int(std::isspace(b) != 0); }); set.flip(); break;
+            case 'n': set.set('\n'); break;
+            case 'r': set.set('\r'); break;
+            case 't': set.set('\t'); break;
+            case 'f': set.set('\f'); break;
+            case 'v': set.set('\v'); break;
+            case '0': set.set(0); break;
+            case 'b':
+            case 'B':
+                fail("word boundaries are not supported");
+            default:
+                if (std::isalnum(static_cast<unsigned char>(c)))
+                    fail(std::string("unknown escape \\") + c);
+                set.set(static_cast<unsigned char>(c));
+            }
+            return set;
+        }
+
+        ByteSet parseClass() {
+            ByteSet set;
+            const bool negated = !atEnd() && peek() == '^';
+            if (negated)
+                ++m_pos;
+
+            bool first = true;
+            while (!atEnd() && (peek() != ']' || first)) {
+                first = false;
+                ByteSet item;
+                int low = -1;
+                if (peek() == '\\') {
+                    ++m_pos;
+                    item = parseEscape();
+                    if (item.count() == 1)
+                        low = firstByte(item);
+                } else {
+                    low = static_cast<unsigned char>(m_pattern[m_pos++]);
+                    item.set(low);
+                }
+
+                // a range like a-z, a '-' before ']' is a literal
+                if (low >= 0 && m_pos + 1 < m_pattern.size() && peek() == '-' && m_pattern[m_pos + 1] != ']') {
+                    ++m_pos;
+                    int high = static_cast<unsigned char>(m_pattern[m_pos++]);
+                    if (high == '\\') {
+                        const ByteSet escaped = parseEscape();
+                        if (escaped.count() != 1)
+                            fail("invalid class range");
+                        high = firstByte(escaped);
+                    }
+                    if (high < low)
+                        fail("invalid class range");
+                    for (int b = low; b <= high; ++b)
+                        item.set(b);
+                }
+                set |= item;
+            }
+            if (atEnd())
+                fail("missing ']'");
+            ++m_pos;
+
+            // case is folded before negation, as [^a] must not match 'A' either
+            set = fold(set);
+            return negated ? ~set : set;
+        }
+
+        ByteSet fold(ByteSet set) const {
+            if (!m_caseInsensitive)
+                return set;
+            for (int b = 'a'; b <= 'z'; ++b) {
+                if (set[b] || set[b - 'a' + 'A']) {
+                    set.set(b);
+                    set.set(b - 'a' + 'A');
+                }
+            }
+            return set;
+        }
+
+        std::string_view m_pattern;
+        size_t m_pos = 0;
+        bool m_caseInsensitive;
+    };
+
+
+    // Thompson NFA of all the patterns
+    struct Nfa
+    {
+        struct State
+        {
+            enum Kind { Byte, Split, Match } kind;
+            size_t set = 0;     // index in sets, for Byte
+            size_t out = 0;
+            size_t out1 = 0;    // second branch, for Split
+            size_t pattern = 0; // for Match
+        };
+
+        std::vector<State> states;
+        std::vector<ByteSet> sets;
+
+        size_t add(State state) {
+            states.push_back(state);
+            return states.size() - 1;
+        }
+
+        // Builds the states for the node leading to next, returns the entry state
+        size_t compile(const Node& node, size_t next) {
+            switch (node.kind) {
+            case Node::Empty:
+                return next;
+            case Node::Set:
+                sets.push_back(node.set);
+                return add({ State::Byte, sets.size() - 1, next });
+            case Node::Concat:
+                for (auto child = node.children.rbegin(); child != node.children.rend(); ++child)
+                    next = compile(**child, next);
+                return next;
+            case Node::Alt: {
+                size_t entry = compile(*node.children.back(), next);
+                for (auto child = node.children.rbegin() + 1; child != node.children.rend(); ++child) {
+                    const size_t branch = compile(**child, next);
+                    entry = add({ State::Split, 0, branch, entry });
+                }
+                return entry;
+            }
+            case Node::Star: {
+                const size_t loop = add({ State::Split, 0, 0, next });
+                const size_t body = compile(*node.children.front(), loop);
+                states[loop].out = body;
+                return loop;
+            }
+            }
+            return next;
+        }
+
+        // Adds the state and all reachable by epsilon moves, only Byte and
+        // Match states are kept as only they matter for DFA states. States
+        // marked with the stamp are visited already, so one array serves all
+        // the closures: a new stamp clears it
+        void closure(size_t state, std::vector<size_t>& visited, size_t stamp, std::vector<size_t>& result) const {
+            std::vector<size_t> stack{ state };
+            while (!stack.empty()) {
+                const size_t s = stack.back();
+                stack.pop_back();
+                if (visited[s] == stamp)
+                    continue;
+                visited[s] = stamp;
+                if (states[s].kind == State::Split) {
+                    stack.push_back(states[s].out1);
+                    stack.push_back(states[s].out);
+                } else {
+                    result.push_back(s);
+                }
+            }
+        }
+    };
+}
+
+
+RegexDfa::RegexDfa(const std::vector<std::string>& patterns, bool caseInsensitive)
+    : m_patternsCount(patterns.size())
+{
+    Nfa nfa;
+    std::vector<size_t> entries;
+    for (size_t i = 0; i < patterns.size(); ++i)
+    {
+        const NodePtr root = Parser(patterns[i], caseInsensitive).parse();
+        m_maxMatchLength = std::max(m_maxMatchLength, maxLength(*root));
+        const size_t match = nfa.add({ Nfa::State::Match, 0, 0, 0, i });
+        entries.push_back(nfa.compile(*root, match));
+    }
+
+    // Bytes that no set tells apart share a class and a table column;
+    // names repeat the same few sets, so each distinct one is looked at once
+    std::unordered_map<ByteSet, size_t> distinctSets;
+    std::vector<size_t> setIndex(nfa.sets.size());
+    for (size_t s = 0; s < nfa.sets.size(); ++s)
+        setIndex[s] = distinctSets.emplace(nfa.sets[s], distinctSets.size()).first->second;
+    std::vector<const ByteSet*> sets(distinctSets.size());
+    for (const auto& [set, index] : distinctSets)
+        sets[index] = &set;
+
+    std::map<std::string, uint8_t> classBySignature;
+    std::vector<uint8_t> representatives;
+    for (int b = 0; b < 256; ++b) {
+        std::string signature;
+        for (const ByteSet* set : sets)
+            signature.push_back((*set)[b] ? '1' : '0');
+        const auto inserted = classBySignature.emplace(signature, static_cast<uint8_t>(classBySignature.size()));
+        if (inserted.second)
+            representatives.push_back(static_cast<uint8_t>(b));
+        m_byteClass[b] = inserted.first->second;
+    }
+    m_classesCount = representatives.size();
+
+    const auto moves = [&](size_t s, size_t c) {
+        return nfa.states[s].kind == Nfa::State::Byte && (*sets[setIndex[nfa.states[s].set]])[representatives[c]];
+    };
+    std::vector<size_t> visited(nfa.states.size(), 0);
+    size_t stamp = 0;
+
+    // Search is unanchored, so every DFA state also includes the entries
+    // of all patterns, as if each pattern started with .*, and the states
+    // the entries lead to on the last byte class. These parts are the bulk
+    // of the states of many names and are shared: a DFA state is keyed by
+    // the shared part it has and the NFA states it has beyond it only.
+    std::vector<size_t> startSet;
+    ++stamp;
+    for (const size_t entry : entries)
+        nfa.closure(entry, visited, stamp, startSet);
+    std::vector<bool> inStart(nfa.states.size());
+    for (const size_t s : startSet)
+        inStart[s] = true;
+
+    // Shared parts: empty for the first state, else what the entries lead to on a class
+    std::vector<std::vector<size_t>> shared(1);
+    std::vector<size_t> sharedOfClass(m_classesCount);
+    {
+        std::map<std::vector<size_t>, size_t> sharedIds{ { {}, 0 } };
+        for (size_t c = 0; c < m_classesCount; ++c) {
+            std::vector<size_t> targets;
+            ++stamp;
+            for (const size_t s : startSet)
+                if (moves(s, c))
+                    nfa.closure(nfa.states[s].out, visited, stamp, targets);
+            targets.erase(std::remove_if(targets.begin(), targets.end(), [&](size_t s) { return inStart[s]; }), targets.end());
+            std::sort(targets.begin(), targets.end());
+            const auto inserted = sharedIds.emplace(targets, shared.size());
+            if (inserted.second)
+                shared.push_back(std::move(targets));
+            sharedOfClass[c] = inserted.first->second;
+        }
+    }
+
+    std::vector<std::vector<bool>> inShared(shared.size(), std::vector<bool>(nfa.states.size()));
+    std::vector<std::vector<size_t>> sharedAccepted(shared.size());
+    std::vector<std::vector<size_t>> sharedMoves(shared.size() * m_classesCount);
+    for (size_t id = 0; id < shared.size(); ++id) {
+        for (const size_t s : shared[id])
+            inShared[id][s] = true;
+        for (const auto* part : { &startSet, &shared[id] })
+            for (const size_t s : *part)
+                if (nfa.states[s].kind == Nfa::State::Match)
+                    sharedAccepted[id].push_back(nfa.states[s].pattern);
+        for (size_t c = 0; c < m_classesCount; ++c) {
+            ++stamp;
+            for (const size_t s : shared[id])
+                if (moves(s, c))
+                    nfa.closure(nfa.states[s].out, visited, stamp, sharedMoves[id * m_classesCount + c]);
+        }
+    }
+
+    // Subset construction, keys are stored once, pending states point to them
+    using Key = std::pair<size_t, std::vector<size_t>>; // shared part, other NFA states sorted
+    std::map<Key, uint32_t> ids;
+    std::vector<std::map<Key, uint32_t>::const_iterator> pending;
+    const auto stateId = [&](size_t sharedPart, std::vector<size_t> nfaStates) {
+        std::sort(nfaStates.begin(), nfaStates.end());
+        Key key(sharedPart, std::move(nfaStates));
+        const auto known = ids.find(key);
+        if (known != ids.end())
+            return known->second;
+        if (ids.size() >= maxDfaStates)
+            throw std::length_error("Patterns are too complex, more than " + std::to_string(maxDfaStates) + " DFA states");
+
+        const auto id = static_cast<uint32_t>(ids.size());
+        std::vector<size_t> accepted = sharedAccepted[sharedPart];
+        for (const size_t s : key.second)
+            if (nfa.states[s].kind == Nfa::State::Match)
+                accepted.push_back(nfa.states[s].pattern);
+        std::sort(accepted.begin(), accepted.end());
+        accepted.erase(std::unique(accepted.begin(), accepted.end()), accepted.end());
+        m_accepting.push_back(!accepted.empty());
+        m_acceptedPatterns.push_back(std::move(accepted));
+        pending.push_back(ids.emplace(std::move(key), id).first);
+        return id;
+    };
+
+    stateId(0, {});
+    for (size_t current = 0; current < pending.size(); ++current)
+    {
+        m_transitions.resize((current + 1) * m_classesCount);
+        for (size_t c = 0; c < m_classesCount; ++c) {
+            const auto& [sharedPart, own] = pending[current]->first;
+            std::vector<size_t> targets;
+            ++stamp;
+            for (const size_t s : own)
+                if (moves(s, c))
+                    nfa.closure(nfa.states[s].out, visited, stamp, targets);
+            for (const size_t s : sharedMoves[sharedPart * m_classesCount + c])
+                if (visited[s] != stamp) {
+                    visited[s] = stamp;
+                    targets.push_back(s);
+                }
+
+            const size_t reached = sharedOfClass[c];
+            targets.erase(std::remove_if(targets.begin(), targets.end(), [&](size_t s) { return inStart[s] || inShared[reached][s]; }),
+                          targets.end());
+            // pending may grow, so the target id is taken before indexing
+            const uint32_t target = stateId(reached, std::move(targets));
+            m_transitions[current * m_classesCount + c] = target;
+        }
+    }
+}
+
+
+void RegexDfa::search(std::string_view text, std::vector<bool>& found) const
+{
+    const auto accept = [&](uint32_t state) {
+        for (const size_t pattern : m_acceptedPatterns[state])
+            found[pattern] = true;
+    };
+
+    uint32_t state = 0;
+    if (m_accepting[state])
+        accept(state);
+
+    const uint32_t* transitions = m_transitions.data();
+    for (const char c : text) {
+        state = transitions[state * m_classesCount + m_byteClass[static_cast<unsigned char>(c)]];
+        if (m_accepting[state])
+            accept(state);
+    }
+}
+
+
+std::string RegexDfa::escape(std::string_view literal)
+{
+    static const std::string_view metacharacters = "\\^$.|?*+()[]{}";
+    std::string escaped;
+    for (const char c : literal) {
+        if (metacharacters.find(c) != std::string_view::npos)
+            escaped.push_back('\\');
+        escaped.push_back(c);
+    }
+    return escaped;
+}
+
+
+std::string RegexDfa::fromGlob(std::string_view glob)
+{
+    static const std::string nameChar = "[^\\s\"'<>/\\\\]";
+    std::string pattern;
+    for (size_t i = 0; i < glob.size(); ++i) {
+        const char c = glob[i];
+        if (c == '*') {
+            pattern += nameChar + "*";
+        } else if (c == '?') {
+            pattern += nameChar;
+        } else if (c == '[' && glob.find(']', i + 2) != std::string_view::npos) {
+            const size_t close = glob.find(']', i + 2);
+            std::string_view set = glob.substr(i + 1, close - i - 1);
+            pattern += '[';
+            if (set.front() == '!') {
+                pattern += '^';
+                set.remove_prefix(1);
+            }
+            for (const char s : set) {
+                if (s == '\\' || s == ']' || s == '^')
+                    pattern += '\\';
+                pattern += s;
+            }
+            pattern += ']';
+            i = close;
+        } else {
+            pattern += escape(std::string_view(&glob[i], 1));
+        }
+    }
+    return pattern;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+
+// Finds which of several regular expressions occur in a text.
+// All the patterns are compiled once into a single DFA over byte classes,
+// so a text is searched in one linear pass whatever the number of patterns.
+// Supported syntax is the ECMAScript subset meaningful for names:
+// literals, '.', [classes], \d \w \s \D \W \S and escapes, groups (...)
+// and (?:...), '|', '*', '+', '?', {m}, {m,} and {m,n}.
+// As in std::regex, '.' doesn't match line breaks.
+class RegexDfa
+{
+public:
+    static constexpr size_t unbounded = SIZE_MAX;
+
+    // Throws std::invalid_argument if a pattern can't be parsed and
+    // std::length_error if the patterns produce too many DFA states
+    explicit RegexDfa(const std::vector<std::string>& patterns, bool caseInsensitive = false);
+
+    size_t size() const { return m_patternsCount; }
+
+    size_t statesCount() const { return m_accepting.size(); }
+
+    // Length of the longest text a pattern may match, unbounded if any
+    // pattern has '*', '+' or {m,}
+    size_t maxMatchLength() const { return m_maxMatchLength; }
+
+    // Sets found[i] for every pattern i present in the text,
+    // found must be sized as size()
+    void search(std::string_view text, std::vector<bool>& found) const;
+
+    // Pattern matching the literal text, i.e. with metacharacters escaped
+    static std::string escape(std::string_view literal);
+
+    // Pattern for a file name glob: '*' and '?' match name characters only,
+    // [classes] are kept, everything else is escaped
+    static std::string fromGlob(std::string_view glob);
+
+private:
+    size_t m_patternsCount = 0;
+    size_t m_maxMatchLength = 0;
+    size_t m_classesCount = 0;
+    uint8_t m_byteClass[256] = {};
+    std::vector<uint32_t> m_transitions; // [state * m_classesCount + class]
+    std::vector<bool> m_accepting;
+    std::vector<std::vector<size_t>> m_acceptedPatterns;
+};
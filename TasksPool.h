@@ -1,79 +1,224 @@
 #pragma once
 
+#include "ThreadAffinity.h"
+
+#include <algorithm>
 #include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
 #include <functional>
-#include <future>
-#include <list>
+#include <map>
 #include <mutex>
 #include <thread>
 #include <vector>
-#include <optional>
 
 
-// Handles tasks instd::function to run in parallel
+// Runs tasks instd::function on a fixed set of worker threads
+// Waiting tasks are dispatched most expensive first, so that a long task
+// doesn't start last and keep a single core busy after all others are done.
+// Tasks of the I/O lane get workers of their own if any are asked for,
+// otherwise they are run by the CPU workers along with the others.
 class TasksPool
 {
 public:
-    void addTask(std::function<void()>&& task) {
-        if (runningTasksCount++ > std::thread::hardware_concurrency()) {
-            --runningTasksCount;
+    enum class Lane
+    {
+        Cpu,
+        Io
+    };
+
+    // CPU workers by default: one per CPU given, or per core if none are
+    static unsigned defaultThreads(const std::vector<unsigned>& cpus = {}) {
+        return cpus.empty() ? std::max(1u, std::thread::hardware_concurrency()) : static_cast<unsigned>(cpus.size());
+    }
+
+    // Workers run on the given CPUs only, all of them if the list is empty;
+    // with pinThreads each worker runs on a single CPU of the list, round robin
+    explicit TasksPool(unsigned threads = 0, unsigned ioThreads = 0, const std::vector<unsigned>& cpus = {}, bool pinThreads = false)
+        : m_ioWorkers(ioThreads > 0)
+    {
+        if (threads == 0)
+            threads = defaultThreads(cpus);
+        for (unsigned n = 0; n < threads + ioThreads; ++n) {
+            std::vector<unsigned> workerCpus = cpus;
+            if (pinThreads && !cpus.empty())
+                workerCpus = { cpus[n % cpus.size()] };
+            m_workers.emplace_back([this, lane = n < threads ? Lane::Cpu : Lane::Io, workerCpus]() {
+                if (!workerCpus.empty())
+                    SetCurrentThreadAffinity(workerCpus);
+                work(lane);
+            });
+        }
+    }
+
+    TasksPool(const TasksPool&) = delete;
+    TasksPool& operator=(const TasksPool&) = delete;
+
+    // Returns false if the pool is cancelled and the task is dropped
+    bool addTask(std::function<void()>&& task, size_t cost = 0, Lane lane = Lane::Cpu) {
+        {
+            std::lock_guard<std::mutex> lock(m_tasksMutex);
+            if (m_cancelled)
+                return false;
+            queue(lane).emplace(cost, std::move(task));
+            ++allTasksCount;
+        }
+        wake(lane).notify_one();
+        return true;
+    }
+
+    // Drops waiting tasks and refuses new ones without waiting for the
+    // running ones; these may check cancelled() to stop early
+    void cancel() {
+        // dropped tasks are destroyed out of the lock, they may own resources to release
+        Tasks dropped, droppedIo;
+        {
             std::lock_guard<std::mutex> lock(m_tasksMutex);
-            m_deferredTasks.emplace_back(std::move(task));
-        } else {
-            m_runningTasks.emplace_back(runTask(m_runningTasks.size(), std::move(task)));
+            m_cancelled = true;
+            dropped.swap(m_cpuTasks);
+            droppedIo.swap(m_ioTasks);
         }
-        ++allTasksCount;
+        m_idleCondition.notify_all();
     }
 
-    void clear() {
-        m_deferredTasks.clear();
-        m_runningTasks.clear(); // will wait for tasks to finish
-        runningTasksCount = 0;
+    bool cancelled() const {
+        return m_cancelled;
     }
 
+    // True when no task is running or waiting to run
+    bool idle() const {
+        std::lock_guard<std::mutex> lock(m_tasksMutex);
+        return isIdle();
+    }
+
+    // Waits until idle() but no longer than the timeout, returns idle()
+    bool waitIdle(std::chrono::milliseconds timeout) const {
+        std::unique_lock<std::mutex> lock(m_tasksMutex);
+        return m_idleCondition.wait_for(lock, timeout, [this]() { return isIdle(); });
+    }
+
+    // Waits for all the tasks, including the waiting ones unless cancelled
     ~TasksPool() {
-    	while(runningTasksCount > 0)
-    		std::this_thread::sleep_for(std::chrono::seconds(1));
+        {
+            std::lock_guard<std::mutex> lock(m_tasksMutex);
+            m_stopping = true;
+        }
+        m_cpuWake.notify_all();
+        m_ioWake.notify_all();
+        for (auto& worker : m_workers)
+            worker.join();
     }
 
     short progress() const {
-        m_zombieTasks.clear();
-        return allTasksCount > 0 ? finishedTasksCount * 100 / allTasksCount : -1;
+        std::lock_guard<std::mutex> lock(m_tasksMutex);
+        return allTasksCount > 0 ? static_cast<short>(finishedTasksCount * 100 / allTasksCount) : -1;
     }
 
 private:
+    using Tasks = std::multimap<size_t, std::function<void()>, std::greater<size_t>>;
 
-    std::future<void> runTask(const size_t id, std::function<void()>&& task) {
-        return std::async(std::launch::async, [=](){
-            task();
-            runNext(id);
-        });
+    Tasks& queue(Lane lane) {
+        return lane == Lane::Io && m_ioWorkers ? m_ioTasks : m_cpuTasks;
     }
 
-    void runNext(size_t const id) {
-        const auto getNextTask = [this,id]() {
-            std::optional<std::function<void()>> nextTask;
-            std::lock_guard<std::mutex> lock(m_tasksMutex);
-            if (!m_deferredTasks.empty()) {
-                nextTask = std::move(m_deferredTasks.front());
-                m_deferredTasks.pop_front();
-                m_zombieTasks.push_back(std::move(m_runningTasks[id]));
+    std::condition_variable& wake(Lane lane) {
+        return lane == Lane::Io && m_ioWorkers ? m_ioWake : m_cpuWake;
+    }
+
+    bool isIdle() const {
+        return m_runningTasksCount == 0 && m_cpuTasks.empty() && m_ioTasks.empty();
+    }
+
+    void work(Lane lane) {
+        for (;;) {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(m_tasksMutex);
+                Tasks& tasks = queue(lane);
+                wake(lane).wait(lock, [&]() { return m_stopping || !tasks.empty(); });
+                if (tasks.empty())
+                    return;
+                task = std::move(tasks.begin()->second);
+                tasks.erase(tasks.begin());
+                ++m_runningTasksCount;
             }
-            return nextTask;
-        };
-        
-        if (auto nextTask = getNextTask()) {
-            m_runningTasks[id] = runTask(id, std::move(nextTask.value()));
-        } else
-            --runningTasksCount;
-        ++finishedTasksCount;
-    }
-
-    std::atomic<size_t> runningTasksCount = 0;
-    std::vector<std::future<void>> m_runningTasks;
-    std::list<std::function<void()>> m_deferredTasks;
-    mutable std::vector<std::future<void>> m_zombieTasks;
+
+            task();
+            task = nullptr;
+
+            {
+                std::lock_guard<std::mutex> lock(m_tasksMutex);
+                --m_runningTasksCount;
+                ++finishedTasksCount;
+            }
+            m_idleCondition.notify_all();
+        }
+    }
+
+    const bool m_ioWorkers;
+    Tasks m_cpuTasks;
+    Tasks m_ioTasks;
     mutable std::mutex m_tasksMutex;
+    std::condition_variable m_cpuWake;
+    std::condition_variable m_ioWake;
+    mutable std::condition_variable m_idleCondition;
+    size_t m_runningTasksCount = 0;
     size_t allTasksCount = 0;
-    std::atomic<size_t> finishedTasksCount = 0;
+    size_t finishedTasksCount = 0;
+    std::atomic<bool> m_cancelled = false;
+    bool m_stopping = false;
+    std::vector<std::thread> m_workers; // last, started once everything else is constructed
+};
+
+
+// Bytes of scanned content allowed in memory at once, unlimited if 0.
+// A request larger than the whole budget is granted once nothing else is
+// held, so a single huge buffer still gets through, alone.
+class MemoryBudget
+{
+public:
+    explicit MemoryBudget(std::uintmax_t limit = 0) : m_limit(limit) {}
+
+    std::uintmax_t limit() const {
+        return m_limit;
+    }
+
+    // Blocks until the bytes fit into the budget, false if cancelled meanwhile
+    bool acquire(std::uintmax_t bytes) {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        if (m_limit == 0)
+            return !m_cancelled;
+        m_released.wait(lock, [&]() { return m_cancelled || m_used == 0 || m_used + bytes <= m_limit; });
+        if (m_cancelled)
+            return false;
+        m_used += bytes;
+        return true;
+    }
+
+    void release(std::uintmax_t bytes) {
+        if (m_limit == 0)
+            return;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_used -= bytes;
+        }
+        m_released.notify_all();
+    }
+
+    // Wakes and refuses all the waiting and later requests
+    void cancel() {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_cancelled = true;
+        }
+        m_released.notify_all();
+    }
+
+private:
+    const std::uintmax_t m_limit;
+    std::uintmax_t m_used = 0;
+    bool m_cancelled = false;
+    std::mutex m_mutex;
+    std::condition_variable m_released;
 };
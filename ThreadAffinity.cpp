@@ -0,0 +1,33 @@
+#include "ThreadAffinity.h"
+
+#if defined(_WIN32)
+#include <windows.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+
+bool SetCurrentThreadAffinity(const std::vector<unsigned>& cpus)
+{
+#if defined(_WIN32)
+    DWORD_PTR mask = 0;
+    for (const unsigned cpu : cpus)
+        if (cpu < sizeof(mask) * 8)
+            mask |= DWORD_PTR(1) << cpu;
+    return mask != 0 && SetThreadAffinityMask(GetCurrentThread(), mask) != 0;
+#elif defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    bool any = false;
+    for (const unsigned cpu : cpus)
+        if (cpu < CPU_SETSIZE) {
+            CPU_SET(cpu, &set);
+            any = true;
+        }
+    return any && pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+    (void)cpus;
+    return false;
+#endif
+}
@@ -0,0 +1,8 @@
+#pragma once
+
+#include <vector>
+
+
+// Restricts the calling thread to the given CPUs (Linux and Windows only,
+// on Windows to the first 64); returns false if not supported or refused
+bool SetCurrentThreadAffinity(const std::vector<unsigned>& cpus);
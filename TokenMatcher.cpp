@@ -0,0 +1,160 @@
+#include "TokenMatcher.h"
+
+#include "BytePairSet.h"
+
+#include <algorithm>
+#include <array>
+#include <utility>
+
+
+namespace
+{
+    enum CharClass : unsigned char
+    {
+        other,
+        token,
+        separator
+    };
+
+    // Bytes above ASCII are taken as letters of UTF-8 names
+    constexpr std::array<unsigned char, 256> MakeCharClasses()
+    {
+        std::array<unsigned char, 256> classes{};
+        for (int c = 0; c < 256; ++c) {
+            const bool letter = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c >= 0x80;
+            if (letter || c == '_' || c == '.' || c == '-')
+                classes[c] = token;
+            else if (c == '/' || c == '\\')
+                classes[c] = separator;
+        }
+        return classes;
+    }
+
+    constexpr std::array<unsigned char, 256> charClasses = MakeCharClasses();
+
+    CharClass ClassOf(char c)
+    {
+        return static_cast<CharClass>(charClasses[static_cast<unsigned char>(c)]);
+    }
+}
+
+
+TokenMatcher::TokenMatcher(std::vector<std::string> names, bool caseInsensitive)
+    : m_names(std::move(names))
+    , m_caseInsensitive(caseInsensitive)
+{
+    // At most half full, so that probe sequences stay short
+    size_t capacity = 16;
+    while (capacity < m_names.size() * 2)
+        capacity *= 2;
+    m_table.assign(capacity, 0);
+    m_mask = capacity - 1;
+    m_sameNames.assign(m_names.size(), 0);
+
+    for (size_t i = 0; i < m_names.size(); ++i)
+    {
+        std::string& name = m_names[i];
+        if (m_caseInsensitive)
+            for (auto& c : name)
+                c = static_cast<char>(FoldAsciiCase(static_cast<unsigned char>(c)));
+        m_hashes.push_back(hash(name.data(), name.size()));
+        if (!isTokenName(name))
+            continue;
+        m_minLength = std::min(m_minLength, name.size());
+        m_maxLength = std::max(m_maxLength, name.size());
+
+        // names folding to the same one share its slot, chained from it
+        size_t slot = m_hashes[i] & m_mask;
+        while (m_table[slot] != 0 && m_names[m_table[slot] - 1] != name)
+            slot = (slot + 1) & m_mask;
+        if (m_table[slot] != 0)
+            m_sameNames[i] = std::exchange(m_sameNames[m_table[slot] - 1], static_cast<uint32_t>(i + 1));
+        else
+            m_table[slot] = static_cast<uint32_t>(i + 1);
+    }
+}
+
+
+bool TokenMatcher::isTokenName(const std::string& name)
+{
+    return !name.empty() && name.back() != '.'
+        && std::all_of(name.begin(), name.end(), [](char c) { return ClassOf(c) == token; });
+}
+
+
+// FNV-1a of the folded bytes
+uint64_t TokenMatcher::hash(const char* token, size_t length) const
+{
+    uint64_t h = 14695981039346656037ull;
+    for (size_t i = 0; i < length; ++i) {
+        auto c = static_cast<unsigned char>(token[i]);
+        if (m_caseInsensitive)
+            c = FoldAsciiCase(c);
+        h = (h ^ c) * 1099511628211ull;
+    }
+    return h ^ (h >> 29);
+}
+
+
+bool TokenMatcher::equals(const char* token, const std::string& name) const
+{
+    for (size_t i = 0; i < name.size(); ++i) {
+        auto c = static_cast<unsigned char>(token[i]);
+        if (m_caseInsensitive)
+            c = FoldAsciiCase(c);
+        if (c != static_cast<unsigned char>(name[i]))
+            return false;
+    }
+    return true;
+}
+
+
+void TokenMatcher::search(std::string_view text, std::vector<bool>& found, bool fileStart, bool fileEnd) const
+{
+    if (m_maxLength == 0)
+        return;
+
+    const char* const data = text.data();
+    const size_t size = text.size();
+    size_t pos = 0;
+
+    // the text may start in the middle of a token
+    if (!fileStart)
+        while (pos < size && ClassOf(data[pos]) == token)
+            ++pos;
+
+    while (pos < size)
+    {
+        while (pos < size && ClassOf(data[pos]) != token)
+            ++pos;
+        const size_t begin = pos;
+        while (pos < size && ClassOf(data[pos]) == token)
+            ++pos;
+        if (begin == size)
+            break;
+
+        // the last token may go on past the text, a directory name is not a file name;
+        // a backslash after a name is rather an escape in a string literal
+        if (pos == size && !fileEnd)
+            break;
+        if (pos < size && data[pos] == '/')
+            continue;
+
+        // a trailing dot ends a sentence rather than a name
+        size_t length = pos - begin;
+        if (data[pos - 1] == '.')
+            --length;
+        if (length < m_minLength || length > m_maxLength)
+            continue;
+
+        const uint64_t h = hash(data + begin, length);
+        for (size_t slot = h & m_mask; m_table[slot] != 0; slot = (slot + 1) & m_mask) {
+            const size_t i = m_table[slot] - 1;
+            if (m_hashes[i] == h && m_names[i].size() == length && equals(data + begin, m_names[i])) {
+                for (size_t same = i + 1; same != 0; same = m_sameNames[same - 1])
+                    found[same - 1] = true;
+                break;
+            }
+        }
+    }
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+
+// Finds which of the searched file names occur in a text as whole names.
+// The text is split once into path-like tokens: runs of identifier
+// characters, '.' and '-' separated by '/' or '\'. The last component of
+// every token is looked up in an open addressing hash table of the names, so
+// foo.h is found in "dir/foo.h" but not in "barfoo.h" or "foo.hpp", and the
+// cost depends on the text size only, not on the number of names.
+// With caseInsensitive names are compared ignoring ASCII case.
+class TokenMatcher
+{
+public:
+    explicit TokenMatcher(std::vector<std::string> names, bool caseInsensitive = false);
+
+    // Names that can be found as tokens: made of token characters, no trailing '.'
+    static bool isTokenName(const std::string& name);
+
+    // Names as they are compared, i.e. lowercased if case insensitive
+    const std::vector<std::string>& names() const { return m_names; }
+
+    size_t maxLength() const { return m_maxLength; }
+
+    // Sets found[i] for every names()[i] present in the text as a token,
+    // found must be sized as names(). Unless the text starts or ends the file,
+    // tokens touching that side may be parts of longer ones and are skipped,
+    // so chunks of a file must overlap by maxLength() + 2: a name with a dot
+    // after it and a byte of context on each side.
+    void search(std::string_view text, std::vector<bool>& found, bool fileStart = true, bool fileEnd = true) const;
+
+private:
+    uint64_t hash(const char* token, size_t length) const;
+    bool equals(const char* token, const std::string& name) const;
+
+    std::vector<std::string> m_names;
+    std::vector<uint64_t> m_hashes;    // by name index
+    std::vector<uint32_t> m_table;     // name index + 1 by hash, 0 in empty slots
+    std::vector<uint32_t> m_sameNames; // by name index, next name index + 1 equal once folded, 0 if none
+    size_t m_mask = 0;
+    size_t m_minLength = SIZE_MAX;
+    size_t m_maxLength = 0;
+    bool m_caseInsensitive;
+};
@@ -115,6 +115,11 @@ bool INIReader::HasSection(const string& section) const
     return pos->first.compare(0, key.length(), key) == 0;
 }
 
+std::set<string> INIReader::Sections() const
+{
+    return _sections;
+}
+
 bool INIReader::HasValue(const string& section, const string& name) const
 {
     string key = MakeKey(section, name);
@@ -135,6 +140,7 @@ int INIReader::ValueHandler(void* user, const char* section, const char* name,
     if (!name)  // Happens when INI_CALL_HANDLER_ON_NEW_SECTION enabled
         return 1;
     INIReader* reader = static_cast<INIReader*>(user);
+    reader->_sections.insert(section);
     string key = MakeKey(section, name);
     if (reader->_values[key].size() > 0)
         reader->_values[key] += "\n";
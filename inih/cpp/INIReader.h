@@ -13,6 +13,7 @@
 #define __INIREADER_H__
 
 #include <map>
+#include <set>
 #include <string>
 #include <list>
 #include <filesystem>
@@ -65,12 +66,16 @@ public:
     // one name=value pair).
     bool HasSection(const std::string& section) const;
 
+    // Return the set of sections found in ini file, as they are written.
+    std::set<std::string> Sections() const;
+
     // Return true if a value exists with the given section and field names.
     bool HasValue(const std::string& section, const std::string& name) const;
 
 private:
     int _error;
     std::map<std::string, std::string> _values;
+    std::set<std::string> _sections;
     static std::string MakeKey(const std::string& section, const std::string& name);
     static int ValueHandler(void* user, const char* section, const char* name,
                             const char* value);
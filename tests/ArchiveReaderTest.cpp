@@ -0,0 +1,133 @@
+#include "ArchiveReader.h"
+
+#include "TestCheck.h"
+
+#include <cstdio>
+#include <fstream>
+#include <map>
+
+using namespace std::filesystem;
+
+
+namespace
+{
+    const path data = DEPSFINDER_TEST_DATA;
+
+    // Members of the sample archives, the long path needs a GNU or pax header in a tar
+    const std::map<std::string, std::string> sampleMembers = {
+        { "pkg/a.cpp", "#include \"foo.h\"\n" },
+        { "pkg/readme.txt", "see bar.h\n" },
+        { "pkg/deep_deep_deep_deep_deep_deep_deep_deep_deep_deep_deep_deep_deep_deep_deep_deep_deep_deep_deep_deep_deep_deep_deep_deep_/b.cpp",
+          "#include \"bar.h\"\nint b;\n" },
+        { "pkg/big.cpp", "// " + std::string(1500, 'x') + "\n#include \"foo.h\"\n" },
+    };
+
+
+    std::string ReadFile(const path& file)
+    {
+        std::ifstream in(file, std::ios::binary);
+        return std::string((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    }
+
+    // A copy of the archive damaged by the given function
+    path Damaged(const path& archive, const std::string& name, const std::function<void(std::string&)>& damage)
+    {
+        std::string content = ReadFile(archive);
+        damage(content);
+        std::ofstream(name, std::ios::binary) << content;
+        return name;
+    }
+
+    // Makes the tar header at the offset valid again after a change
+    void UpdateTarChecksum(std::string& content, size_t header)
+    {
+        content.replace(header + 148, 8, 8, ' ');
+        unsigned sum = 0;
+        for (size_t i = header; i < header + 512; ++i)
+            sum += static_cast<unsigned char>(content[i]);
+        char checksum[8];
+        std::snprintf(checksum, sizeof(checksum), "%06o", sum);
+        content.replace(header + 148, 7, checksum, 7);
+    }
+
+    bool Read(const path& archive, std::map<std::string, std::string>& members,
+              const std::function<bool(const std::string&)>& accept = [](const std::string&) { return true; })
+    {
+        members.clear();
+        return ReadArchive(archive, accept, [&members](const std::string& member, std::string& content) {
+            members[member] = content;
+            return true;
+        });
+    }
+
+
+    void SampleArchives()
+    {
+        CHECK(IsArchive("sample.tar") && IsArchive("SAMPLE.ZIP") && !IsArchive("sample.tar.bz2") && !IsArchive("tar"));
+
+        std::map<std::string, std::string> members;
+        CHECK(Read(data / "sample.tar", members));
+        CHECK(members == sampleMembers);
+
+        CHECK(Read(data / "sample.tar", members, [](const std::string& member) { return path(member).extension() == ".cpp"; }));
+        CHECK(members.size() == 3 && members.count("pkg/readme.txt") == 0);
+
+        // stopping on a member isn't damage
+        size_t seen = 0;
+        CHECK(ReadArchive(data / "sample.tar", [](const std::string&) { return true; }, [&seen](const std::string&, std::string&) {
+            return ++seen < 2;
+        }));
+        CHECK(seen == 2);
+
+        // without zlib the compressed formats are not archives, nor deflated zip members readable
+        if (!IsArchive("sample.tar.gz"))
+            return;
+        CHECK(Read(data / "sample.tar.gz", members));
+        CHECK(members == sampleMembers);
+        CHECK(Read(data / "sample.zip", members));
+        CHECK(members == sampleMembers);
+    }
+
+
+    void DamagedArchives()
+    {
+        // the first member header follows the one of the directory
+        const path tar = data / "sample.tar";
+        constexpr size_t member = 512;
+        std::map<std::string, std::string> members;
+
+        // cut in the data of a member and right after the last one, before the end blocks
+        CHECK(!Read(Damaged(tar, "cut.tar", [](std::string& content) { content.resize(2 * 512 + 5); }), members));
+        CHECK(!Read(Damaged(tar, "ended.tar", [](std::string& content) {
+            content.resize((content.find_last_not_of('\0') / 512 + 1) * 512);
+        }), members));
+        CHECK(members.size() == sampleMembers.size());
+        // a header with a wrong checksum, then with a size larger than the archive
+        CHECK(!Read(Damaged(tar, "checksum.tar", [](std::string& content) { content[member] = 'P'; }), members));
+        CHECK(!Read(Damaged(tar, "size.tar", [](std::string& content) {
+            content.replace(member + 124, 11, "77777777777");
+            UpdateTarChecksum(content, member);
+        }), members));
+        CHECK(!ReadArchive(data / "missing.tar", {}, {}));
+
+        if (!IsArchive("sample.tar.gz"))
+            return;
+        CHECK(!Read(Damaged(data / "sample.tar.gz", "cut.tar.gz", [](std::string& content) { content.resize(content.size() / 2); }), members));
+
+        // without the central directory at the end, and with a member larger than the archive
+        const path zip = data / "sample.zip";
+        CHECK(!Read(Damaged(zip, "cut.zip", [](std::string& content) { content.resize(content.size() - 30); }), members));
+        CHECK(!Read(Damaged(zip, "size.zip", [](std::string& content) {
+            const size_t file = content.find("PK\x01\x02", content.find("PK\x01\x02") + 4);
+            content.replace(file + 20, 4, "\xff\xff\xff\x7f");
+        }), members));
+    }
+}
+
+
+int main()
+{
+    SampleArchives();
+    DamagedArchives();
+    return FailedChecks();
+}
@@ -0,0 +1,120 @@
+#include "DepsFinder.h"
+
+#include "TestCheck.h"
+
+using namespace std::filesystem;
+
+
+namespace
+{
+    // With a small memory budget files are cut into chunks of this size
+    constexpr size_t chunkSize = 64 << 10;
+    constexpr size_t fileSize = 2 * chunkSize + (8 << 10);
+
+    struct Placed
+    {
+        std::string text;                  // as written in the scanned file
+        std::vector<std::string> reported; // searched files or pattern it's reported under
+    };
+
+    // Context around a name and whether the token engine takes it as the name
+    struct Context
+    {
+        const char* before;
+        const char* after;
+        bool token;
+    };
+
+    const Context contexts[] = {
+        { " ", " ", true },
+        { "\"", "\"", true },
+        { " ", ". ", true },
+        { "q", " ", false },
+        { " ", "q ", false },
+    };
+
+
+    Result Search(const Job& job, const InMemoryFiles& files, bool chunked)
+    {
+        SearchOptions options;
+        options.performance.threads = 2;
+        options.performance.maxBufferMemory = chunked ? 2 * chunkSize : 0;
+        return FindDependencies({ job }, files, options);
+    }
+
+
+    // Every name is put once per file, around a chunk boundary at every
+    // offset it may cross it at; split and whole files must give the same
+    void CompareChunkedWithWhole(MatchEngine engine, const std::vector<Placed>& placed,
+                                 const std::list<std::pair<std::string, std::string>>& patterns = {}, bool caseInsensitive = false)
+    {
+        Job job;
+        job.engine = engine;
+        job.searchedPatterns = patterns;
+        job.caseInsensitive = caseInsensitive;
+        for (const auto& name : placed)
+            for (const auto& reported : name.reported)
+                if (reported.front() == '/')
+                    job.searchedFiles.push_back(reported);
+
+        // expected reports by file
+        std::map<path, std::set<std::string>> expected;
+        InMemoryFiles files;
+        std::string filler;
+        while (filler.size() < fileSize)
+            filler += "int x = 0;\n";
+        filler.resize(fileSize);
+
+        for (const size_t boundary : { chunkSize, 2 * chunkSize })
+            for (const auto& name : placed)
+                for (const auto& context : contexts) {
+                    const std::string text = context.before + name.text + context.after;
+                    for (size_t shift = 0; shift <= text.size() + 2; ++shift) {
+                        const path file = "/src/" + std::to_string(files.size()) + ".cpp";
+                        std::string& content = files[file] = filler;
+                        content.replace(boundary + 1 - shift, text.size(), text);
+                        job.scannedFiles.push_back(file);
+                        if (engine != MatchEngine::Token || context.token || name.reported.front().front() != '/')
+                            expected[file].insert(name.reported.begin(), name.reported.end());
+                    }
+                }
+
+        const Result whole = Search(job, files, false);
+        const Result chunked = Search(job, files, true);
+        CHECK(whole.complete && chunked.complete);
+        CHECK(whole.dependencies == chunked.dependencies);
+
+        std::map<path, std::set<std::string>> found;
+        for (const auto& [searched, where] : chunked.dependencies.front())
+            for (const auto& file : where)
+                found[file].insert(searched);
+        CHECK(found == expected);
+    }
+}
+
+
+int main()
+{
+    const std::vector<Placed> names = {
+        { "alpha.h", { "/inc/alpha.h" } },
+        { "beta_gamma.hpp", { "/inc/beta_gamma.hpp" } },
+        { "d.h", { "/inc/d.h" } },
+    };
+
+    CompareChunkedWithWhole(MatchEngine::Literal, names);
+    CompareChunkedWithWhole(MatchEngine::Token, names);
+
+    std::vector<Placed> withPattern = names;
+    withPattern.push_back({ "gen_123.h", { "gen_[0-9]{3}\\.h" } });
+    CompareChunkedWithWhole(MatchEngine::Dfa, withPattern, { { "gen_[0-9]{3}\\.h", "gen_[0-9]{3}\\.h" } });
+
+    // ignoring case, names differing in case only are all reported
+    const std::vector<Placed> foldedNames = {
+        { "Alpha.H", { "/inc/alpha.h" } },
+        { "foo.h", { "/a/Foo.h", "/b/foo.h", "/c/FOO.H" } },
+    };
+    for (const auto engine : { MatchEngine::Literal, MatchEngine::Token, MatchEngine::Dfa })
+        CompareChunkedWithWhole(engine, foldedNames, {}, true);
+
+    return FailedChecks();
+}
@@ -0,0 +1,158 @@
+#include "DependenciesDelta.h"
+#include "DepsFinderConfig.h"
+
+#include "TestCheck.h"
+
+#include <fstream>
+
+using namespace std::filesystem;
+
+
+namespace
+{
+    const Dependencies previous = {
+        { "/inc/foo.h", { "/src/a.cpp", "/src/b.cpp" } },
+        { "/inc/bar.h", { "/src/a.cpp" } },
+        { "/inc/gone.h", { "/src/c.cpp" } },
+    };
+
+    const Dependencies current = {
+        { "/inc/foo.h", { "/src/a.cpp", "/src/d.cpp" } },
+        { "/inc/bar.h", { "/src/a.cpp" } },
+        { "/inc/new.h", { "/src/b.cpp", "archive.tar!pkg/e.cpp" } },
+    };
+
+
+    bool SameEdges(const DependencyEdges& l, const DependencyEdges& r)
+    {
+        return l.names == r.names && l.edges == r.edges;
+    }
+
+
+    void RoundTrips()
+    {
+        WriteDependencies("roundtrip.txt", current);
+        Dependencies read;
+        CHECK(ReadDependencies("roundtrip.txt", read));
+        CHECK(read == current);
+        CHECK(!ReadDependencies("nosuch.txt", read));
+
+        const DependencyEdges edges = ToEdges(current);
+        CHECK(WriteSnapshot("roundtrip.snapshot", edges));
+        DependencyEdges snapshot;
+        CHECK(ReadSnapshot("roundtrip.snapshot", snapshot));
+        CHECK(SameEdges(snapshot, edges));
+    }
+
+
+    void Deltas()
+    {
+        const DependenciesDelta delta = CompareDependencies(ToEdges(previous), ToEdges(current));
+        const Dependencies added = {
+            { "/inc/foo.h", { "/src/d.cpp" } },
+            { "/inc/new.h", { "/src/b.cpp", "archive.tar!pkg/e.cpp" } },
+        };
+        const Dependencies removed = {
+            { "/inc/foo.h", { "/src/b.cpp" } },
+            { "/inc/gone.h", { "/src/c.cpp" } },
+        };
+        CHECK(delta.added == added);
+        CHECK(delta.removed == removed);
+
+        const DependenciesDelta none = CompareDependencies(ToEdges(current), ToEdges(current));
+        CHECK(none.added.empty() && none.removed.empty());
+    }
+
+
+    // Damaged snapshots are rejected before anything is allocated for their counts
+    void DamagedSnapshots()
+    {
+        WriteSnapshot("damaged.snapshot", ToEdges(current));
+        std::string content;
+        {
+            std::ifstream in("damaged.snapshot", std::ios::binary);
+            content.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        }
+        const auto rejected = [](const std::string& damaged) {
+            std::ofstream("damaged.snapshot", std::ios::binary | std::ios::trunc) << damaged;
+            DependencyEdges edges = ToEdges(previous);
+            const bool read = ReadSnapshot("damaged.snapshot", edges);
+            return !read && SameEdges(edges, ToEdges(previous));
+        };
+
+        // after the magic and the version comes the names count
+        constexpr size_t namesCount = 12;
+        CHECK(rejected(content.substr(0, content.size() - 3)));
+        CHECK(rejected(content.substr(0, namesCount) + std::string("\xff\xff\xff\x7f", 4) + content.substr(namesCount + 4)));
+        CHECK(rejected(content.substr(0, content.size() - 8 * ToEdges(current).edges.size() - 8) + std::string(8, '\xff')));
+        CHECK(rejected("DEPSSNAP"));
+        CHECK(rejected(""));
+    }
+
+
+    // The second run writes the changes since the first one next to the output
+    void JobResults()
+    {
+        Params params;
+        params.output = "job.txt";
+        params.delta = true;
+        params.snapshot = true;
+        remove("job.txt");
+        remove("job.snapshot");
+
+        WriteJobResults(params, previous);
+        CHECK(exists("job.snapshot"));
+        WriteJobResults(params, current);
+
+        std::ifstream delta("job.delta.txt");
+        const std::string changes((std::istreambuf_iterator<char>(delta)), std::istreambuf_iterator<char>());
+        CHECK(changes.find("Name of the file \"/inc/new.h\" is added to file(s):") != std::string::npos);
+        CHECK(changes.find("Name of the file \"/inc/gone.h\" is removed from file(s):") != std::string::npos);
+
+        // a damaged snapshot falls back to the text results
+        std::ofstream("job.snapshot", std::ios::binary | std::ios::trunc) << "DEPSSNAP";
+        WriteJobResults(params, previous);
+        std::ifstream fallback("job.delta.txt");
+        const std::string fallbackChanges((std::istreambuf_iterator<char>(fallback)), std::istreambuf_iterator<char>());
+        CHECK(fallbackChanges.find("Name of the file \"/inc/gone.h\" is added to file(s):") != std::string::npos);
+
+        // partial results don't touch the snapshot, the unscanned files are listed instead
+        const auto snapshotTime = last_write_time("job.snapshot");
+        WriteJobResults(params, current, { "/src/z.cpp" });
+        CHECK(last_write_time("job.snapshot") == snapshotTime);
+        CHECK(exists("job.unscanned.txt"));
+        WriteJobResults(params, current);
+        CHECK(!exists("job.unscanned.txt"));
+    }
+
+
+    // Without a snapshot the output is the previous results, partial ones go aside
+    void PartialResults()
+    {
+        Params params;
+        params.output = "text.txt";
+        params.delta = true;
+
+        WriteJobResults(params, current);
+        WriteJobResults(params, previous, { "/src/z.cpp" });
+        Dependencies partial;
+        CHECK(ReadDependencies("text.partial.txt", partial) && partial == previous);
+        Dependencies kept;
+        CHECK(ReadDependencies("text.txt", kept) && kept == current);
+
+        WriteJobResults(params, current);
+        CHECK(file_size("text.delta.txt") == 0);
+        CHECK(!exists("text.partial.txt") && !exists("text.unscanned.txt"));
+    }
+}
+
+
+int main()
+{
+    RoundTrips();
+    Deltas();
+    DamagedSnapshots();
+    JobResults();
+    PartialResults();
+    return FailedChecks();
+}
@@ -0,0 +1,160 @@
+#include "DepsFinder.h"
+#include "GitRepository.h"
+
+#include "TestCheck.h"
+
+#include <algorithm>
+#include <cstring>
+
+using namespace std::filesystem;
+
+
+namespace
+{
+    // A bare repository: v1 (a lightweight tag in packed-refs) is in a pack
+    // with offset deltas, master and the annotated tag v2 in a pack with ref
+    // deltas, up to three deep, and the feature branch in loose objects
+    const path repositoryDir = path(DEPSFINDER_TEST_DATA) / "sample.git";
+
+    const std::vector<std::string> v1Files = { "src/f0.cpp", "src/f1.cpp", "src/f2.cpp", "src/f3.cpp", "src/f4.cpp" };
+    const std::vector<std::string> v2Files = { "src/f0.cpp", "src/f1.cpp", "src/f2.cpp", "src/f3.cpp", "src/f4.cpp",
+                                               "src/g0.cpp", "src/g1.cpp", "src/g2.cpp" };
+
+
+    // Objects are named by the SHA-1 of "<type> <size>\0<content>"
+    GitObjectId Sha1(const std::string& text)
+    {
+        uint32_t h[5] = { 0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0 };
+        std::string message = text;
+        message += '\x80';
+        while (message.size() % 64 != 56)
+            message += '\0';
+        const uint64_t bits = static_cast<uint64_t>(text.size()) * 8;
+        for (int i = 7; i >= 0; --i)
+            message += static_cast<char>(bits >> (8 * i));
+
+        const auto rotate = [](uint32_t x, int n) { return x << n | x >> (32 - n); };
+        for (size_t block = 0; block < message.size(); block += 64) {
+            uint32_t w[80];
+            for (int i = 0; i < 16; ++i)
+                w[i] = static_cast<uint32_t>(static_cast<unsigned char>(message[block + 4 * i])) << 24
+                     | static_cast<uint32_t>(static_cast<unsigned char>(message[block + 4 * i + 1])) << 16
+                     | static_cast<uint32_t>(static_cast<unsigned char>(message[block + 4 * i + 2])) << 8
+                     | static_cast<uint32_t>(static_cast<unsigned char>(message[block + 4 * i + 3]));
+            for (int i = 16; i < 80; ++i)
+                w[i] = rotate(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+
+            uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+            for (int i = 0; i < 80; ++i) {
+                const uint32_t f = i < 20 ? (b & c) | (~b & d) : i < 40 ? b ^ c ^ d : i < 60 ? (b & c) | (b & d) | (c & d) : b ^ c ^ d;
+                const uint32_t k = i < 20 ? 0x5A827999 : i < 40 ? 0x6ED9EBA1 : i < 60 ? 0x8F1BBCDC : 0xCA62C1D6;
+                const uint32_t t = rotate(a, 5) + f + e + k + w[i];
+                e = d;
+                d = c;
+                c = rotate(b, 30);
+                b = a;
+                a = t;
+            }
+            h[0] += a;
+            h[1] += b;
+            h[2] += c;
+            h[3] += d;
+            h[4] += e;
+        }
+
+        GitObjectId id;
+        for (size_t i = 0; i < id.size(); ++i)
+            id[i] = static_cast<unsigned char>(h[i / 4] >> (24 - 8 * (i % 4)));
+        return id;
+    }
+
+
+    // Lists the files of the revision, checking every blob against its id
+    std::vector<std::string> CheckedFiles(const GitRepository& repository, const std::string& revision)
+    {
+        std::vector<std::string> files;
+        const auto tree = repository.resolveTree(revision);
+        CHECK(tree);
+        if (!tree)
+            return files;
+
+        CHECK(repository.listTree(*tree, [&](const std::string& file, const GitObjectId& blob) {
+            files.push_back(file);
+            std::string content;
+            GitRepository::ObjectType type = GitRepository::ObjectType::None;
+            CHECK(repository.read(blob, content, &type));
+            CHECK(type == GitRepository::ObjectType::Blob);
+            CHECK(Sha1("blob " + std::to_string(content.size()) + '\0' + content) == blob);
+            CHECK(repository.size(blob) == content.size());
+        }));
+        std::sort(files.begin(), files.end());
+        return files;
+    }
+
+
+    void Revisions()
+    {
+        CHECK(Sha1("abc") == GitRepository::fromHex("a9993e364706816aba3e25717850c26c9cd0d89d"));
+
+        const GitRepository repository(repositoryDir);
+        CHECK(repository.valid());
+        CHECK(CheckedFiles(repository, "v1") == v1Files);
+        CHECK(CheckedFiles(repository, "5eca1ad") == v1Files);
+        CHECK(CheckedFiles(repository, "v2") == v2Files);
+        CHECK(CheckedFiles(repository, "HEAD") == v2Files);
+
+        std::vector<std::string> featureFiles = v2Files;
+        featureFiles.push_back("src/h.cpp");
+        std::sort(featureFiles.begin(), featureFiles.end());
+        CHECK(CheckedFiles(repository, "refs/heads/feature") == featureFiles);
+
+        CHECK(!repository.resolveTree("nosuch"));
+        CHECK(!GitRepository(path(DEPSFINDER_TEST_DATA) / "nosuch.git").valid());
+    }
+
+
+    // Delta bases are evicted and read again without changing what is read
+    void BaseCache()
+    {
+        std::map<std::string, std::string> contents;
+        for (const size_t limit : { size_t(64) << 20, size_t(0), size_t(3000) }) {
+            GitRepository repository(repositoryDir);
+            repository.setBaseCacheLimit(limit);
+            for (int pass = 0; pass < 2; ++pass)
+                for (const auto& revision : { "v1", "v2" })
+                    repository.listTree(*repository.resolveTree(revision), [&](const std::string& file, const GitObjectId& blob) {
+                        std::string content;
+                        CHECK(repository.read(blob, content));
+                        const auto [known, added] = contents.try_emplace(revision + (":" + file), content);
+                        CHECK(added || known->second == content);
+                    });
+        }
+        CHECK(contents.size() == v1Files.size() + v2Files.size());
+    }
+
+
+    void SearchRevisions()
+    {
+        Job job;
+        job.searchedFiles = { "/inc/foo.h", "/inc/bar.h" };
+        job.gitRepository = repositoryDir;
+        job.scannedRevisions = { "v1", "feature", "nosuch" };
+        const Result result = FindDependencies({ job });
+
+        const std::set<path> foo = { "v1:src/f0.cpp", "v1:src/f2.cpp", "v1:src/f4.cpp",
+                                     "feature:src/f0.cpp", "feature:src/f2.cpp", "feature:src/f4.cpp", "feature:src/h.cpp" };
+        CHECK(result.dependencies[0].at("/inc/foo.h") == foo);
+        CHECK(result.dependencies[0].at("/inc/bar.h").count("feature:src/g2.cpp") == 1);
+        CHECK(result.dependencies[0].at("/inc/bar.h").count("v1:src/f0.cpp") == 0);
+        CHECK(result.unreadable == std::vector<path>{ repositoryDir.generic_string() + "@nosuch" });
+    }
+}
+
+
+int main()
+{
+    Revisions();
+    BaseCache();
+    SearchRevisions();
+    return FailedChecks();
+}
@@ -0,0 +1,108 @@
+#include "BytePairSet.h"
+#include "LiteralMatcher.h"
+
+#include "TestCheck.h"
+
+#include <algorithm>
+#include <random>
+
+
+namespace
+{
+    // Letters of both cases and the bytes around them, which folding must leave as they are
+    const std::string alphabet = "aAbBzZ@[`{.\x80\xc1\xda\xfa";
+
+    std::string RandomText(std::mt19937& random, size_t maxLength, const std::string& letters = alphabet)
+    {
+        std::string text(std::uniform_int_distribution<size_t>(0, maxLength)(random), ' ');
+        for (auto& c : text)
+            c = letters[random() % letters.size()];
+        return text;
+    }
+
+    std::string Folded(std::string text)
+    {
+        for (auto& c : text)
+            c = static_cast<char>(FoldAsciiCase(static_cast<unsigned char>(c)));
+        return text;
+    }
+
+
+    // Every kernel, the selected one and the scalar one included, finds
+    // what a byte by byte comparison does, in both case modes
+    void Kernels()
+    {
+        const std::vector<const char*> kernels = BytePairSet::kernelNames();
+        CHECK(kernels.front() == std::string(BytePairSet::kernelName()));
+        CHECK(kernels.back() == std::string("scalar"));
+        std::cout << "Kernels:";
+        for (const char* kernel : kernels)
+            std::cout << " " << kernel;
+        std::cout << "\n";
+
+        std::mt19937 random(1);
+        for (const bool foldCase : { false, true })
+            for (int round = 0; round < 2000; ++round) {
+                BytePairSet pairs(foldCase);
+                std::vector<std::string> inserted;
+                for (size_t n = 1 + random() % 6; n > 0; --n) {
+                    inserted.push_back(RandomText(random, 2));
+                    inserted.back().resize(2, 'a');
+                    pairs.insert(static_cast<unsigned char>(inserted.back()[0]), static_cast<unsigned char>(inserted.back()[1]));
+                }
+
+                // unaligned, with tails of every length after whole blocks
+                const std::string text = RandomText(random, 100);
+                const size_t offset = random() % 3;
+                const std::string_view window = std::string_view(text).substr(std::min(offset, text.size()));
+                std::vector<size_t> expected;
+                for (size_t i = 0; i + 1 < window.size(); ++i) {
+                    const std::string pair(window.substr(i, 2));
+                    if (std::any_of(inserted.begin(), inserted.end(), [&](const std::string& p) {
+                            return foldCase ? Folded(p) == Folded(pair) : p == pair;
+                        }))
+                        expected.push_back(i);
+                }
+
+                for (const char* kernel : kernels) {
+                    std::vector<size_t> candidates;
+                    pairs.findCandidates(window.data(), window.size(), candidates, kernel);
+                    std::sort(candidates.begin(), candidates.end());
+                    CHECK(candidates == expected);
+                }
+            }
+    }
+
+
+    // Names are found where std::string::find finds them, in lowercase if case insensitive
+    void Names()
+    {
+        std::mt19937 random(2);
+        for (const bool caseInsensitive : { false, true })
+            for (int round = 0; round < 300; ++round) {
+                std::vector<std::string> names;
+                for (size_t n = 1 + random() % 8; n > 0; --n)
+                    names.push_back(RandomText(random, 6, "aAbB.@"));
+                const LiteralMatcher matcher(names, caseInsensitive);
+
+                // long enough to be searched window by window once in a while
+                const std::string text = RandomText(random, round % 50 == 0 ? 200000 : 300, "aAbB.@[");
+                std::vector<bool> found(names.size());
+                matcher.search(text, found);
+                for (size_t n = 0; n < names.size(); ++n) {
+                    const bool expected = names[n].empty() ? false
+                        : caseInsensitive ? Folded(text).find(Folded(names[n])) != std::string::npos
+                                          : text.find(names[n]) != std::string::npos;
+                    CHECK(found[n] == expected);
+                }
+            }
+    }
+}
+
+
+int main()
+{
+    Kernels();
+    Names();
+    return FailedChecks();
+}
@@ -0,0 +1,169 @@
+#include "RegexDfa.h"
+
+#include "TestCheck.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iterator>
+#include <random>
+#include <regex>
+
+
+namespace
+{
+    // Random patterns over a small alphabet, so that texts often match them
+    class PatternGenerator
+    {
+    public:
+        explicit PatternGenerator(unsigned seed) : m_random(seed) {}
+
+        std::string pattern() {
+            return alternation(0);
+        }
+
+        std::string text(const std::string& alphabet, size_t maxLength) {
+            std::string text(pick(maxLength + 1), ' ');
+            for (auto& c : text)
+                c = alphabet[pick(alphabet.size())];
+            return text;
+        }
+
+    private:
+        size_t pick(size_t count) {
+            return std::uniform_int_distribution<size_t>(0, count - 1)(m_random);
+        }
+
+        std::string alternation(int depth) {
+            std::string result = concatenation(depth);
+            while (pick(4) == 0)
+                result += "|" + concatenation(depth);
+            return result;
+        }
+
+        std::string concatenation(int depth) {
+            std::string result;
+            for (size_t n = 1 + pick(3); n > 0; --n)
+                result += quantified(depth);
+            return result;
+        }
+
+        // Groups get bounded quantifiers only, std::regex backtracks
+        // exponentially on nested unbounded ones
+        std::string quantified(int depth) {
+            static const char* const quantifiers[] = { "?", "{2}", "{0,2}", "{1,3}", "*", "+", "{1,}" };
+            std::string result = atom(depth);
+            if (pick(3) == 0)
+                result += quantifiers[pick(result[0] == '(' ? 4 : std::size(quantifiers))];
+            return result;
+        }
+
+        std::string atom(int depth) {
+            static const char* const atoms[] = { "a", "b", "c", "A", ".", "\\.", "[ab]", "[^a]", "[a-c]", "\\d", "\\w", "\\s", "\\W", "1" };
+            if (depth < 3 && pick(5) == 0)
+                return (pick(2) ? "(" : "(?:") + alternation(depth + 1) + ")";
+            return atoms[pick(std::size(atoms))];
+        }
+
+        std::mt19937 m_random;
+    };
+
+
+    // All the patterns are searched at once and must agree with std::regex one by one
+    void CompareWithStdRegex(bool caseInsensitive)
+    {
+        PatternGenerator generator(caseInsensitive ? 2 : 1);
+        const auto flags = caseInsensitive ? std::regex::ECMAScript | std::regex::icase : std::regex::ECMAScript;
+        int mismatches = 0;
+        for (int round = 0; round < 200 && mismatches < 10; ++round) {
+            std::vector<std::string> patterns;
+            std::vector<std::regex> regexes;
+            for (int n = 0; n < 4; ++n) {
+                patterns.push_back(generator.pattern());
+                regexes.emplace_back(patterns.back(), flags);
+            }
+            const RegexDfa dfa(patterns, caseInsensitive);
+
+            for (int t = 0; t < 20; ++t) {
+                const std::string text = generator.text("abcAB.1 \n\r_", 24);
+                std::vector<bool> found(dfa.size());
+                dfa.search(text, found);
+                for (size_t n = 0; n < patterns.size(); ++n) {
+                    if (found[n] == std::regex_search(text, regexes[n]))
+                        continue;
+                    ++mismatches;
+                    std::cout << "/" << patterns[n] << "/ " << (found[n] ? "found" : "not found") << " in \"" << text << "\"\n";
+                }
+            }
+        }
+        CHECK(mismatches == 0);
+    }
+
+
+    void EscapedLiterals()
+    {
+        for (const std::string literal : { "foo.h", "a+b(c)[d]{e}", "x|y^$\\z", "*?.*" }) {
+            const RegexDfa dfa({ RegexDfa::escape(literal) });
+            CHECK(dfa.maxMatchLength() == literal.size());
+            std::vector<bool> found(1);
+            dfa.search("prefix " + literal + " suffix", found);
+            CHECK(found[0]);
+            CHECK(std::regex_match(literal, std::regex(RegexDfa::escape(literal))));
+
+            found[0] = false;
+            dfa.search(literal.substr(1), found);
+            CHECK(!found[0]);
+        }
+    }
+
+
+    void Globs()
+    {
+        const RegexDfa dfa({ RegexDfa::fromGlob("*_generated.h"), RegexDfa::fromGlob("v?.hpp") });
+        const auto search = [&dfa](const std::string& text) {
+            std::vector<bool> found(dfa.size());
+            dfa.search(text, found);
+            return found;
+        };
+        CHECK(search("#include \"foo_generated.h\"")[0]);
+        CHECK(!search("#include \"foo_generated_h\"")[0]);
+        CHECK(search("#include <v1.hpp>")[1]);
+        CHECK(!search("#include <v12.hpp>")[1]);
+    }
+
+    // Many names build about a state per character of the names, as a trie,
+    // not a copy of the entries of all the names per state
+    void ManyNames()
+    {
+        static const char* const parts[] = { "core", "gui", "widget", "private", "impl", "io", "string", "map", "x" };
+        std::vector<std::string> names, patterns;
+        size_t length = 0;
+        for (size_t n = 0; n < 5000; ++n) {
+            std::string name = std::string(parts[n % std::size(parts)]) + "_" + parts[n / 7 % std::size(parts)] + std::to_string(n) + ".h";
+            length += name.size();
+            patterns.push_back(RegexDfa::escape(name));
+            names.push_back(std::move(name));
+        }
+
+        for (const bool caseInsensitive : { false, true }) {
+            const auto start = std::chrono::steady_clock::now();
+            const RegexDfa dfa(patterns, caseInsensitive);
+            CHECK(std::chrono::steady_clock::now() - start < std::chrono::seconds(30));
+            CHECK(dfa.statesCount() <= length + 1);
+
+            std::vector<bool> found(dfa.size());
+            dfa.search("#include \"" + names[42] + "\"\n#include <" + names[4999] + ">\n" + names[7].substr(1), found);
+            CHECK(std::count(found.begin(), found.end(), true) == 2 && found[42] && found[4999]);
+        }
+    }
+}
+
+
+int main()
+{
+    CompareWithStdRegex(false);
+    CompareWithStdRegex(true);
+    EscapedLiterals();
+    Globs();
+    ManyNames();
+    return FailedChecks();
+}
@@ -0,0 +1,145 @@
+#include "DepsFinder.h"
+#include "TasksPool.h"
+
+#include "TestCheck.h"
+
+#include <cstdio>
+#include <fstream>
+#include <future>
+
+using namespace std::filesystem;
+
+
+namespace
+{
+    // Waiting tasks are run most expensive first, the I/O ones by workers of their own
+    void Pool()
+    {
+        std::vector<size_t> order;
+        std::promise<void> gate;
+        std::shared_future<void> opened = gate.get_future().share();
+        std::thread::id cpuWorker, ioWorker;
+        {
+            TasksPool pool(1, 1);
+            pool.addTask([&]() { opened.wait(); cpuWorker = std::this_thread::get_id(); });
+            for (const size_t cost : { 1, 3, 2 })
+                pool.addTask([&order, cost]() { order.push_back(cost); }, cost);
+            pool.addTask([&]() { ioWorker = std::this_thread::get_id(); }, 0, TasksPool::Lane::Io);
+            CHECK(!pool.idle());
+            gate.set_value();
+            CHECK(pool.waitIdle(std::chrono::seconds(60)));
+            CHECK(pool.progress() == 100);
+        }
+        CHECK((order == std::vector<size_t>{ 3, 2, 1 }));
+        CHECK(cpuWorker != ioWorker);
+
+        // cancelled, the waiting tasks are dropped and new ones refused
+        std::promise<void> cancelGate;
+        std::shared_future<void> cancelOpened = cancelGate.get_future().share();
+        bool dropped = true;
+        {
+            TasksPool pool(1, 0, { 0 }, true);
+            pool.addTask([cancelOpened]() { cancelOpened.wait(); });
+            pool.addTask([&dropped]() { dropped = false; });
+            pool.cancel();
+            CHECK(pool.cancelled());
+            CHECK(!pool.addTask([]() {}));
+            cancelGate.set_value();
+        }
+        CHECK(dropped);
+    }
+
+
+    // A request larger than the budget waits for everything else to be released
+    void Budget()
+    {
+        MemoryBudget budget(100);
+        CHECK(budget.acquire(60));
+        CHECK(budget.acquire(40));
+
+        auto huge = std::async(std::launch::async, [&budget]() { return budget.acquire(500); });
+        CHECK(huge.wait_for(std::chrono::milliseconds(50)) == std::future_status::timeout);
+        budget.release(60);
+        CHECK(huge.wait_for(std::chrono::milliseconds(50)) == std::future_status::timeout);
+        budget.release(40);
+        CHECK(huge.get());
+
+        auto waiting = std::async(std::launch::async, [&budget]() { return budget.acquire(1); });
+        budget.cancel();
+        CHECK(!waiting.get());
+        CHECK(!budget.acquire(0));
+        CHECK(MemoryBudget().acquire(size_t(1) << 40));
+    }
+
+
+    // A tar of a single member
+    void WriteTar(const path& archive, const std::string& member, const std::string& content)
+    {
+        std::string header(512, '\0');
+        header.replace(0, member.size(), member);
+        header.replace(100, 7, "0000644");
+        char size[12];
+        std::snprintf(size, sizeof(size), "%011llo", static_cast<unsigned long long>(content.size()));
+        header.replace(124, 11, size);
+        header[156] = '0';
+        header.replace(257, 6, "ustar\0", 6);
+        header.replace(148, 8, 8, ' ');
+        unsigned sum = 0;
+        for (const char c : header)
+            sum += static_cast<unsigned char>(c);
+        char checksum[8];
+        std::snprintf(checksum, sizeof(checksum), "%06o", sum);
+        header.replace(148, 7, checksum, 7);
+
+        std::ofstream out(archive, std::ios::binary);
+        out << header << content << std::string((512 - content.size() % 512) % 512 + 2 * 512, '\0');
+    }
+
+
+    // Archives are read within the budget, on the I/O lane if there is one: reading
+    // them on the searching one would wait for buffers whose searches are queued behind
+    void ReadersWithArchives()
+    {
+        create_directories("pool");
+        Job job;
+        job.searchedFiles = { "/inc/foo.h" };
+        std::string filler;
+        while (filler.size() < (1 << 20))
+            filler += "int x = 0;\n";
+        for (int n = 0; n < 2; ++n) {
+            const path archive = "pool/" + std::to_string(n) + ".tar";
+            WriteTar(archive, "a.cpp", filler + "#include \"foo.h\"\n");
+            job.scannedArchives.push_back(archive);
+        }
+        for (int n = 0; n < 6; ++n) {
+            const path file = "pool/" + std::to_string(n) + ".cpp";
+            std::ofstream(file, std::ios::binary) << filler.substr(0, 256 << 10) << "#include \"foo.h\"\n";
+            job.scannedFiles.push_back(file);
+        }
+
+        std::set<path> expected(job.scannedFiles.begin(), job.scannedFiles.end());
+        for (const auto& archive : job.scannedArchives)
+            expected.insert(archive.generic_string() + "!a.cpp");
+
+        for (const std::uintmax_t maxBufferMemory : { std::uintmax_t(0), std::uintmax_t(512) << 10 })
+            for (const unsigned ioThreads : { 0u, 1u }) {
+                SearchOptions options;
+                options.deadline = std::chrono::steady_clock::now() + std::chrono::seconds(30);
+                options.performance.threads = 1;
+                options.performance.ioThreads = ioThreads;
+                options.performance.maxBufferMemory = maxBufferMemory;
+                Result result = FindDependencies({ job }, {}, options);
+                CHECK(result.complete);
+                CHECK(result.dependencies[0]["/inc/foo.h"] == expected);
+            }
+    }
+}
+
+
+int main()
+{
+    Pool();
+    Budget();
+    ReadersWithArchives();
+    return FailedChecks();
+}
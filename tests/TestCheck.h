@@ -0,0 +1,19 @@
+#pragma once
+
+#include <iostream>
+
+
+// Counts and reports failed checks, main() returns the count
+inline int& FailedChecks()
+{
+    static int failed = 0;
+    return failed;
+}
+
+#define CHECK(condition)                                                              \
+    do {                                                                              \
+        if (!(condition)) {                                                           \
+            ++FailedChecks();                                                         \
+            std::cout << __FILE__ << ":" << __LINE__ << ": failed " #condition "\n";  \
+        }                                                                             \
+    } while (false)